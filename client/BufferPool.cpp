@@ -0,0 +1,98 @@
+#include "BufferPool.h"
+#include <misc.h>   // CryptoPP::SecureWipeBuffer
+
+BufferPool::BufferPool(size_t maxRetainedBytes) : maxRetained(maxRetainedBytes) {}
+
+BufferPool& BufferPool::shared() {
+    static BufferPool pool;
+    return pool;
+}
+
+size_t BufferPool::classFor(size_t size) {
+    size_t cls = 0;
+    while (cls < CLASS_COUNT && (size_t(1) << (MIN_CLASS_SHIFT + cls)) < size) ++cls;
+    return cls;   // CLASS_COUNT = larger than any class
+}
+
+std::vector<uint8_t> BufferPool::acquire(size_t size) {
+    size_t cls = classFor(size);
+    std::vector<uint8_t> buf;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counters.acquires;
+        if (cls < CLASS_COUNT && !freeLists[cls].empty()) {
+            buf = std::move(freeLists[cls].back());
+            freeLists[cls].pop_back();
+            ++counters.hits;
+            --counters.buffersRetained;
+            counters.bytesRetained -= buf.capacity();
+        }
+    }
+    if (buf.capacity() == 0 && cls < CLASS_COUNT) {
+        // Allocate the whole class so the buffer can serve any later request of it
+        buf.reserve(size_t(1) << (MIN_CLASS_SHIFT + cls));
+    }
+    // A pooled buffer is filed at full capacity and already zero, so this
+    // only shrinks it – no memset on a hit; a new one is zero-filled here
+    buf.resize(size);
+    return buf;
+}
+
+void BufferPool::release(std::vector<uint8_t>&& buf) {
+    std::vector<uint8_t> owned = std::move(buf);
+    size_t cap = owned.capacity();
+
+    // Buffers carry plaintext and keys: wipe all of the storage, whether it
+    // is kept or freed, before it leaves the caller. Kept buffers stay at
+    // full size, which also lets acquire() skip zero-filling them.
+    if (cap > 0) {
+        owned.resize(cap);
+        CryptoPP::SecureWipeBuffer(owned.data(), cap);
+    }
+
+    // Largest class the capacity fully covers
+    size_t cls = CLASS_COUNT;
+    if (cap >= (size_t(1) << MIN_CLASS_SHIFT) && cap <= (size_t(1) << MAX_CLASS_SHIFT)) {
+        cls = classFor(cap);
+        if ((size_t(1) << (MIN_CLASS_SHIFT + cls)) > cap) --cls;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.releases;
+    if (cls == CLASS_COUNT || freeLists[cls].size() >= MAX_PER_CLASS ||
+        counters.bytesRetained + cap > maxRetained) {
+        ++counters.dropped;
+        return;   // `owned` frees the storage
+    }
+    freeLists[cls].push_back(std::move(owned));
+    ++counters.buffersRetained;
+    counters.bytesRetained += cap;
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void BufferPool::setMaxRetainedBytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxRetained = bytes;
+    trimTo(bytes);
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    trimTo(0);
+}
+
+void BufferPool::trimTo(size_t bytes) {
+    // Largest buffers go first
+    for (size_t cls = CLASS_COUNT; cls-- > 0 && counters.bytesRetained > bytes;) {
+        auto& list = freeLists[cls];
+        while (!list.empty() && counters.bytesRetained > bytes) {
+            counters.bytesRetained -= list.back().capacity();
+            --counters.buffersRetained;
+            list.pop_back();
+        }
+    }
+}
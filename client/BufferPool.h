@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Size-classed free lists of byte buffers, so the short-lived vectors of a
+// message loop (received contents, plaintext, ciphertext, I/O chunks) reuse
+// storage instead of going back to the allocator every time.
+//
+// Classes are powers of two from 256 B to 16 MiB. acquire() rounds the
+// request up to its class; release() files a buffer under the largest
+// class its capacity covers, so any vector can be returned. Buffers outside
+// the class range, or past the retention limits, are simply freed – the
+// pool never holds more than maxRetainedBytes, which keeps RSS flat.
+// release() securely wipes the whole capacity (pooled buffers hold
+// plaintext and keys), so a pooled buffer comes back already zeroed and
+// acquire() doesn't have to fill it again.
+//
+// Thread-safe; the worker pool acquires and releases concurrently.
+class BufferPool {
+public:
+    static constexpr size_t MIN_CLASS_SHIFT = 8;    // 256 B
+    static constexpr size_t MAX_CLASS_SHIFT = 24;   // 16 MiB
+    static constexpr size_t CLASS_COUNT     = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+    static constexpr size_t MAX_PER_CLASS   = 64;   // idle buffers kept per class
+    static constexpr size_t DEFAULT_MAX_RETAINED = 64u << 20;
+
+    struct Stats {
+        uint64_t acquires        = 0;
+        uint64_t hits            = 0;   // served from a free list
+        uint64_t releases        = 0;
+        uint64_t dropped         = 0;   // released but freed (out of range / over limit)
+        size_t   buffersRetained = 0;
+        size_t   bytesRetained   = 0;   // capacity held on the free lists
+
+        double hitRate() const { return acquires ? double(hits) / double(acquires) : 0.0; }
+    };
+
+    explicit BufferPool(size_t maxRetainedBytes = DEFAULT_MAX_RETAINED);
+
+    // Process-wide pool used by Connection, ProtocolParser, CryptoManager and Client
+    static BufferPool& shared();
+
+    // Vector of `size` bytes (zero-filled) with at least the class capacity
+    std::vector<uint8_t> acquire(size_t size);
+
+    // Hands the storage back; `buf` is left empty
+    void release(std::vector<uint8_t>&& buf);
+
+    Stats stats() const;
+    void  setMaxRetainedBytes(size_t bytes);   // trims immediately if over
+    void  trim();                              // frees every idle buffer
+
+private:
+    static size_t classFor(size_t size);        // smallest class holding `size`
+    void          trimTo(size_t bytes);         // caller holds mutex
+
+    mutable std::mutex                                       mutex;
+    std::array<std::vector<std::vector<uint8_t>>, CLASS_COUNT> freeLists;
+    size_t                                                   maxRetained;
+    Stats                                                    counters;
+};
+
+// A buffer on loan from a pool, handed back when the lease goes out of scope
+class PooledBuffer {
+public:
+    explicit PooledBuffer(size_t size, BufferPool& pool = BufferPool::shared())
+            : pool(&pool), buf(pool.acquire(size)) {}
+    ~PooledBuffer() { if (pool) pool->release(std::move(buf)); }
+
+    PooledBuffer(PooledBuffer&& o) noexcept : pool(o.pool), buf(std::move(o.buf)) { o.pool = nullptr; }
+    PooledBuffer& operator=(PooledBuffer&&) = delete;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    std::vector<uint8_t>&       operator*()        { return buf; }
+    const std::vector<uint8_t>& operator*()  const { return buf; }
+    std::vector<uint8_t>*       operator->()       { return &buf; }
+    const std::vector<uint8_t>* operator->() const { return &buf; }
+
+    uint8_t* data()       { return buf.data(); }
+    size_t   size() const { return buf.size(); }
+
+private:
+    BufferPool*          pool;
+    std::vector<uint8_t> buf;
+};
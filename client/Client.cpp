@@ -1,15 +1,31 @@
 #include "Client.h"
 #include "ProtocolBuilder.h"
 #include "ProtocolParser.h"
+#include "IdentityStore.h"
+#include "BufferPool.h"
+#include "Metrics.h"
 #include "aes.h"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 
 // bring in AES::BLOCKSIZE
 using CryptoPP::AES;
 
+// helper: a failed write only costs a key exchange after the next restart
+static void persistKey(KeyStore* store, const ClientId& id, KeyStore::Kind kind,
+                       const std::vector<uint8_t>& value) {
+    if (!store) return;
+    try {
+        store->put(id, kind, value);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: key for " << id.hex() << " not saved: " << e.what() << "\n";
+    }
+}
+
 // helper: bytes → hex
 static std::string toHex(const std::vector<uint8_t>& b) {
     std::ostringstream oss;
@@ -18,28 +34,18 @@ static std::string toHex(const std::vector<uint8_t>& b) {
     }
     return oss.str();
 }
-// helper: hex → bytes
-static std::vector<uint8_t> hexToBytes(const std::string& s) {
-    std::vector<uint8_t> v;
-    v.reserve(s.size()/2);
-    for (size_t i=0; i<s.size(); i+=2) {
-        v.push_back(std::stoul(s.substr(i,2), nullptr, 16));
-    }
-    return v;
-}
-
 Client::Client() {
     readServerInfo();
     connection = std::make_unique<Connection>(serverAddress, serverPort);
-    if (checkIfRegistered()) {
-        loadMeInfo();
-    }
+    registered = loadIdentity();
 }
 
 
 void Client::run() {
-    if (checkIfRegistered()) {
-        std::cout << "Welcome back, your ID = " << toHex(clientId) << "\n";
+    std::cout << "AES kernel: " << CryptoManager::aesImplementation()
+              << " (cpu: " << CryptoManager::cpuFeatures() << ")\n";
+    if (registered) {
+        std::cout << "Welcome back, your ID = " << clientId.hex() << "\n";
     }
     showMenu();
 
@@ -73,26 +79,240 @@ void Client::readServerInfo() {
     serverPort    = std::stoi(line.substr(p+1));
 }
 
-bool Client::checkIfRegistered() {
-    std::ifstream f("me.info");
-    return f.good();
+bool Client::loadIdentity() {
+    // One read of the identity file; the private key goes straight into
+    // CryptoManager so type-2 messages can be decrypted after a restart
+    Identity id;
+    try {
+        if (IdentityStore::loadBinary(IdentityStore::BINARY_FILE, id)) {
+            crypto.loadPrivateKeyDER(id.privateKeyDER);
+        } else if (IdentityStore::importText(IdentityStore::TEXT_FILE, id)) {
+            // Older installs only have me.info – import it into me.bin once
+            crypto.loadPrivateKeyPEM(id.privateKeyPEM);
+            id.privateKeyDER = crypto.getPrivateKeyDER();
+            IdentityStore::saveBinary(IdentityStore::BINARY_FILE, id);
+        } else {
+            return false;
+        }
+        clientId = ClientId::fromVector(id.clientId);
+    } catch (const std::exception& e) {
+        std::cerr << "Could not restore identity: " << e.what() << "\n";
+        return false;
+    }
+
+    myUsername = id.username;
+    openKeyStore();
+    return true;
+}
+
+void Client::saveIdentity() {
+    Identity id;
+    id.username      = myUsername;
+    id.clientId      = clientId.toVector();
+    id.privateKeyDER = crypto.getPrivateKeyDER();
+    id.privateKeyPEM = crypto.getPrivateKeyPEM();
+    if (!IdentityStore::saveBinary(IdentityStore::BINARY_FILE, id) ||
+        !IdentityStore::saveText(IdentityStore::TEXT_FILE, id)) {
+        std::cerr << "Warning: could not write identity files\n";
+    }
+}
+
+void Client::openKeyStore() {
+    // A new identity can't read the old store; KeyStore starts it afresh
+    keyStore.reset();
+    try {
+        keyStore = std::make_unique<KeyStore>(crypto, crypto.getPrivateKeyDER());
+        restoreGroups();
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: keys will not be kept across runs: " << e.what() << "\n";
+    }
+}
+
+void Client::installSymKey(const ClientId& id, const std::vector<uint8_t>& key) {
+    // symKeyStore and the expanded AES contexts in CryptoManager change together
+    symKeyStore[id] = key;
+    crypto.setSessionKey(id, key);
+    persistKey(keyStore.get(), id, KeyStore::Kind::SymmetricKey, key);
 }
 
-void Client::loadMeInfo() {
-    std::ifstream f("me.info");
-    std::string name, hexid, pem;
-    std::getline(f, name);
-    std::getline(f, hexid);
-    std::getline(f, pem);
-    clientId      = hexToBytes(hexid);
-    privateKeyPEM = pem;
+void Client::installPeerPublicKey(const ClientId& id, const std::vector<uint8_t>& der) {
+    peerPubKeys[id] = der;
+    crypto.setPeerPublicKey(id, der);
+    persistKey(keyStore.get(), id, KeyStore::Kind::PublicKey, der);
 }
 
-void Client::saveMeInfo(const std::string& username) {
-    std::ofstream f("me.info");
-    f << username << "\n"
-      << toHex(clientId) << "\n"
-      << privateKeyPEM  << "\n";
+const std::vector<uint8_t>* Client::findSymKey(const ClientId& id) {
+    if (const auto* key = symKeyStore.find(id)) return key;
+    std::vector<uint8_t> key;
+    if (!keyStore || !keyStore->get(id, KeyStore::Kind::SymmetricKey, key)) return nullptr;
+    crypto.setSessionKey(id, key);
+    return &(symKeyStore[id] = std::move(key));
+}
+
+const std::vector<uint8_t>* Client::findPublicKey(const ClientId& id) {
+    if (const auto* der = peerPubKeys.find(id)) return der;
+    std::vector<uint8_t> der;
+    if (!keyStore || !keyStore->get(id, KeyStore::Kind::PublicKey, der)) return nullptr;
+    try {
+        crypto.setPeerPublicKey(id, der);
+    } catch (const std::exception&) {
+        return nullptr;   // not a key we can use; fetch it again
+    }
+    return &(peerPubKeys[id] = std::move(der));
+}
+
+AESSessionPtr Client::sessionFor(const ClientId& id) {
+    if (auto session = crypto.session(id)) return session;
+    return findSymKey(id) ? crypto.session(id) : nullptr;
+}
+
+void Client::ensurePublicKeys(const std::vector<ClientId>& ids) {
+    // Only IDs neither in memory nor in keyStore go to the network: PUBKEY_BATCH_MAX
+    // per 607 request, all pipelined, or one 602 each if the server
+    // predates 607
+    std::vector<ClientId>        missing;
+    FlatHashMap<ClientId, bool>  seen;
+    for (const auto& id : ids) {
+        if (seen.contains(id) || findPublicKey(id)) continue;
+        seen[id] = true;
+        missing.push_back(id);
+    }
+    if (missing.empty()) return;
+
+    if (serverSupportsBatchKeys) {
+        bool rejected = false;
+        for (size_t off = 0; off < missing.size(); off += PUBKEY_BATCH_MAX) {
+            size_t n = std::min(PUBKEY_BATCH_MAX, missing.size() - off);
+            std::vector<ClientId> chunk(missing.begin() + off, missing.begin() + off + n);
+            auto req = ProtocolBuilder::buildGetPublicKeysRequest(clientId, chunk);
+            connection->submit(req, [this, &rejected](const std::vector<uint8_t>& raw) {
+                auto resp = ProtocolParser::parseView(raw);
+                if (resp.code != 2107) {
+                    rejected = rejected || resp.code == 9000;
+                    return;
+                }
+                try {
+                    for (const auto& rec : ProtocolParser::parsePublicKeys(resp.payload)) {
+                        installPeerPublicKey(rec.clientId, rec.publicKeyDER);
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Malformed public key list: " << e.what() << "\n";
+                }
+            });
+        }
+        connection->drain();
+        if (!rejected) return;
+        serverSupportsBatchKeys = false;
+    }
+
+    for (const auto& id : missing) {
+        if (peerPubKeys.contains(id)) continue;
+        auto req = ProtocolBuilder::buildGetPublicKeyRequest(clientId, id);
+        connection->submit(req, [this, id](const std::vector<uint8_t>& raw) {
+            auto resp = ProtocolParser::parseView(raw);
+            if (resp.code != 2102 || resp.payload.size() <= 16) return;
+            installPeerPublicKey(id, std::vector<uint8_t>(resp.payload.begin() + 16,
+                                                          resp.payload.end()));
+        });
+    }
+    connection->drain();
+}
+
+std::string Client::groupName(const ClientId& id) const {
+    const Group* g = groups.find(id);
+    return g ? g->name : id.hex();
+}
+
+void Client::installGroup(Group group, const std::vector<uint8_t>& key) {
+    // Names are only local labels: a clash with a different group gets the
+    // ID prefix appended so both stay addressable
+    ClientId id = group.id;
+    auto byName = groupByName.find(group.name);
+    if (byName != groupByName.end() && byName->second != id) {
+        group.name += "#" + id.hex().substr(0, 8);
+    }
+    const Group* old = groups.find(id);
+    bool added = old == nullptr;
+    if (old && old->name != group.name) {
+        groupByName.erase(old->name);
+    }
+    groupByName[group.name] = id;
+    Group& stored = groups[id] = std::move(group);
+    installSymKey(id, key);
+    persistGroup(stored, added);
+}
+
+bool Client::acceptGroupKey(const ClientId& sender, const Group& group) {
+    // Group and peer keys share symKeyStore and the session table, so a group
+    // ID must never name us or a peer; otherwise a type 5 could replace the
+    // key we use with that peer. The sender has to be in the member list it
+    // sends, and a known group is only re-keyed by one of its stored members.
+    auto isMember = [&sender](const std::vector<ClientId>& members) {
+        return std::find(members.begin(), members.end(), sender) != members.end();
+    };
+    if (!isMember(group.members)) return false;
+    if (group.id == clientId || group.id == ClientId()) return false;
+    if (const Group* known = groups.find(group.id)) {
+        return isMember(known->members);
+    }
+    return !idToName.contains(group.id) && !findPublicKey(group.id) && !findSymKey(group.id);
+}
+
+void Client::persistGroup(const Group& group, bool added) {
+    // [2 nameLen][name][2 count][count × 16 member]
+    if (!keyStore) return;
+    std::vector<uint8_t> info(4 + group.name.size() + ClientId::SIZE * group.members.size());
+    uint8_t* p = info.data();
+    wire::U16::write(p, static_cast<uint16_t>(group.name.size()));
+    std::memcpy(p + 2, group.name.data(), group.name.size());
+    p += 2 + group.name.size();
+    wire::U16::write(p, static_cast<uint16_t>(group.members.size()));
+    p += 2;
+    for (const auto& m : group.members) {
+        std::memcpy(p, m.data(), ClientId::SIZE);
+        p += ClientId::SIZE;
+    }
+    persistKey(keyStore.get(), group.id, KeyStore::Kind::Group, info);
+
+    if (added) {
+        std::vector<uint8_t> list;
+        list.reserve(ClientId::SIZE * groups.size());
+        for (const auto& entry : groups) {
+            list.insert(list.end(), entry.key.data(), entry.key.data() + ClientId::SIZE);
+        }
+        persistKey(keyStore.get(), ClientId(), KeyStore::Kind::GroupList, list);
+    }
+}
+
+void Client::restoreGroups() {
+    // Only names and members are read here; group keys load on first use
+    std::vector<uint8_t> list;
+    if (!keyStore || !keyStore->get(ClientId(), KeyStore::Kind::GroupList, list)) return;
+
+    for (size_t off = 0; off + ClientId::SIZE <= list.size(); off += ClientId::SIZE) {
+        ClientId id(list.data() + off);
+        std::vector<uint8_t> info;
+        if (groups.contains(id) || !keyStore->get(id, KeyStore::Kind::Group, info)) continue;
+        try {
+            ByteView view(info.data(), info.size());
+            Group group;
+            group.id = id;
+            size_t nameLen = wire::U16::read(view.sub(0, 2).data());
+            ByteView name  = view.sub(2, nameLen);
+            group.name.assign(name.begin(), name.end());
+            size_t pos   = 2 + nameLen;
+            size_t count = wire::U16::read(view.sub(pos, 2).data());
+            pos += 2;
+            ByteView members = view.sub(pos, ClientId::SIZE * count);
+            for (size_t i = 0; i < count; ++i) {
+                group.members.emplace_back(members.data() + ClientId::SIZE * i);
+            }
+            groupByName[group.name] = id;
+            groups[id] = std::move(group);
+        } catch (const std::exception&) {
+            // unreadable entry; the group is forgotten until its key comes again
+        }
+    }
 }
 
 void Client::showMenu() {
@@ -102,10 +322,17 @@ void Client::showMenu() {
               "120) Request for clients list\n"
               "130) Request for public key\n"
               "140) Request for waiting messages\n"
+              "141) Wait for messages (delivered as they arrive)\n"
               "150) Send a text message\n"
               "151) Send a request for symmetric key\n"
               "152) Send your symmetric key\n"
               "153) Send a file\n"
+              "154) Toggle compression of texts and files\n"
+              "160) Create a group\n"
+              "161) Send a group message\n"
+              "170) Show buffer pool statistics\n"
+              "171) Show request and crypto metrics\n"
+              "172) Toggle periodic metrics dump (metrics.json)\n"
               "0) Exit client\n"
               "? ";
 }
@@ -116,199 +343,489 @@ void Client::handleChoice(int c) {
         case 120: requestClientsList();    break;
         case 130: requestPublicKey();      break;
         case 140: requestWaitingMessages();break;
+        case 141: waitForMessages();       break;
         case 150: sendTextMessage();       break;
         case 151: requestSymmetricKey();   break;
         case 152: sendSymmetricKey();      break;
         case 153: sendFileMessage();     break;
+        case 154: toggleCompression();     break;
+        case 160: createGroup();           break;
+        case 161: sendGroupMessage();      break;
+        case 170: showBufferPoolStats();   break;
+        case 171: showMetrics();           break;
+        case 172: toggleMetricsDump();     break;
     }
 }
 
 
 void Client::registerUser() {
+    RequestScope scope(600);
     std::cout << "Registration selected.\n";
     std::cout << "Enter username: ";
-    std::string username; std::cin >> username;
+    std::string name; std::cin >> name;
 
     crypto.generateRSAKeyPair();
     auto pubDER = crypto.getPublicKeyDER();
-    auto req = ProtocolBuilder::buildRegisterRequest(username, pubDER);
-    auto raw = connection->sendAndReceive(req);
-    auto resp = ProtocolParser::parse(raw);
+    auto req = ProtocolBuilder::buildRegisterRequest(name, pubDER);
+    const auto& raw = connection->sendAndReceiveView(req);
+    auto resp = ProtocolParser::parseView(raw);
 
     if (resp.code != 2100) {
         std::cerr << "Registration failed, code=" << resp.code << "\n";
         return;
     }
 
-    clientId.assign(resp.payload.begin(), resp.payload.begin()+16);
-    privateKeyPEM = crypto.getPrivateKeyPEM();
-    saveMeInfo(username);
+    clientId = ClientId(resp.payload.sub(0, 16).data());
+    myUsername = name;
+    registered = true;
+    saveIdentity();
+    openKeyStore();
 
-    std::cout << "Registered! Your ID=" << toHex(clientId) << "\n";
+    std::cout << "Registered! Your ID=" << clientId.hex() << "\n";
 }
 
 
 void Client::requestClientsList() {
-    auto request = ProtocolBuilder::buildListRequest(clientId);
-    auto rawResponse = connection->sendAndReceive(request);
-    auto resp = ProtocolParser::parse(rawResponse);
-
-    if (resp.code != 2101) {
-        std::cout << "server responded with an error\n";
-        return;
+    // Only users added / removed since clientsListVersion are transferred;
+    // the server sends the whole list when it can't produce a delta
+    if (serverSupportsListDelta) {
+        auto request = ProtocolBuilder::buildListDeltaRequest(clientId, clientsListVersion);
+        auto resp = ProtocolParser::parseView(connection->sendAndReceiveView(request));
+
+        if (resp.code == 2108) {
+            ClientListDelta delta;
+            try {
+                delta = ProtocolParser::parseClientListDelta(resp.payload);
+            } catch (const std::exception&) {
+                std::cerr << "Malformed clients list payload\n";
+                return;
+            }
+            if (delta.full) {
+                clientsMap.clear();
+                idToName.clear();
+            }
+            for (const auto& id : delta.removed) removeClient(id);
+            for (const auto& rec : delta.added)  addClient(rec);
+            clientsListVersion = delta.version;
+        } else if (resp.code == 9000) {
+            // Server predates 608 – use the full 601 list from now on
+            serverSupportsListDelta = false;
+        } else {
+            std::cout << "server responded with an error\n";
+            return;
+        }
     }
 
-    const size_t RECORD_SIZE = 16 + 255;
-    size_t payloadSize = resp.payload.size();
-    if (payloadSize % RECORD_SIZE != 0) {
-        std::cerr << "Malformed clients list payload\n";
-        return;
+    if (!serverSupportsListDelta) {
+        auto request = ProtocolBuilder::buildListRequest(clientId);
+        auto resp = ProtocolParser::parseView(connection->sendAndReceiveView(request));
+        if (resp.code != 2101) {
+            std::cout << "server responded with an error\n";
+            return;
+        }
+        std::vector<ClientRecord> records;
+        try {
+            records = ProtocolParser::parseClientList(resp.payload);
+        } catch (const std::exception&) {
+            std::cerr << "Malformed clients list payload\n";
+            return;
+        }
+        clientsMap.clear();
+        idToName.clear();
+        for (const auto& rec : records) addClient(rec);
     }
 
-    size_t count = payloadSize / RECORD_SIZE;
-    clientsMap.clear();
-
-    if (count == 0) {
+    if (clientsMap.empty()) {
         std::cout << "No other clients registered.\n";
         return;
     }
+    for (const auto& entry : clientsMap) {
+        std::cout << entry.first << "\n"; // print only the name
+    }
+}
 
-    for (size_t i = 0; i < count; ++i) {
-        auto baseIt = resp.payload.begin() + i * RECORD_SIZE;
-
-        std::vector<uint8_t> id(baseIt, baseIt + 16);
-
-        std::string name;
-        for (size_t j = 0; j < 255; ++j) {
-            char c = static_cast<char>(*(baseIt + 16 + j));
-            if (c == '\0') break;
-            name.push_back(c);
-        }
+void Client::addClient(const ClientRecord& rec) {
+    // A re-sent ID replaces whatever name it had before
+    removeClient(rec.clientId);
+    clientsMap[rec.name] = rec.clientId;
+    idToName[rec.clientId] = rec.name;
+}
 
-        clientsMap[name] = id;
-        std::cout << name << "\n"; // print only the name
+void Client::removeClient(const ClientId& id) {
+    const std::string* name = idToName.find(id);
+    if (!name) return;
+    auto byName = clientsMap.find(*name);
+    if (byName != clientsMap.end() && byName->second == id) {
+        clientsMap.erase(byName);
     }
+    idToName.erase(id);
 }
 
 
 void Client::requestPublicKey() {
-    // Ask for username (not ID)
-    std::cout << "Enter username: ";
+    // Ask for one or more usernames (not IDs), separated by spaces
+    std::cout << "Enter username(s): ";
+    std::string line;
+    std::getline(std::cin, line);
+    std::istringstream names(line);
+
+    std::vector<std::string> users;
+    std::vector<ClientId>    targetIds;
     std::string username;
-    std::cin >> username;
-
-    // Check if username is known
-    if (clientsMap.find(username) == clientsMap.end()) {
-        std::cerr << "No such user in memory. Run option 120 first.\n";
-        return;
+    while (names >> username) {
+        // Check if username is known
+        auto it = clientsMap.find(username);
+        if (it == clientsMap.end()) {
+            std::cerr << "No such user in memory: " << username << ". Run option 120 first.\n";
+            continue;
+        }
+        users.push_back(username);
+        targetIds.push_back(it->second);
     }
 
-    // Get client ID for given username
-    const std::vector<uint8_t>& targetId = clientsMap[username];
-
-    // Build and send the request
-    auto req = ProtocolBuilder::buildGetPublicKeyRequest(clientId, targetId);
-    auto raw = connection->sendAndReceive(req);
-    auto resp = ProtocolParser::parse(raw);
+    // Cached keys are reused; the rest come back in one 607 round trip
+    ensurePublicKeys(targetIds);
 
-    if (resp.code != 2102) {
-        std::cerr << "Server returned error code: " << resp.code << "\n";
-        return;
+    for (size_t i = 0; i < users.size(); ++i) {
+        const auto* key = peerPubKeys.find(targetIds[i]);
+        if (!key) {
+            std::cerr << "Server has no public key for " << users[i] << "\n";
+            continue;
+        }
+        std::cout << "Public key for " << users[i] << " (" << targetIds[i].hex() << "):\n"
+                  << toHex(*key) << "\n";
     }
+}
 
-    // Payload = [16 bytes clientId] + [DER key]
-    std::vector<uint8_t> returnedId(resp.payload.begin(), resp.payload.begin() + 16);
-    std::vector<uint8_t> pubKeyDER(resp.payload.begin() + 16, resp.payload.end());
+void Client::requestWaitingMessages() {
+    // Pages of at most fetchPageBytes / fetchPageCount (605) are requested
+    // until the server reports nothing more pending. Each response is
+    // consumed straight off the socket entry by entry, so neither a big
+    // mailbox nor a big file has to fit in memory.
+    bool more = true;
+    while (more) {
+        bool paged = serverSupportsPaging;
+        RequestScope scope(paged ? 605 : 604);   // decryption counts as this fetch's crypto
+        auto req = paged
+                ? ProtocolBuilder::buildFetchPageRequest(clientId, fetchPageBytes, fetchPageCount)
+                : ProtocolBuilder::buildFetchMessagesRequest(clientId);
+        auto hdr = ProtocolParser::parseHeader(connection->requestStream(req).data());
+
+        if (hdr.code != (paged ? 2105 : 2104)) {
+            PooledBuffer discard(hdr.payloadSize);
+            connection->readChunk(discard.data(), discard.size());
+            if (paged && hdr.code == 9000) {
+                // Server predates 605 – fall back to the unpaged 604 fetch
+                serverSupportsPaging = false;
+                continue;
+            }
+            std::cout << "server responded with an error\n";
+            return;
+        }
 
-    std::string idHex = toHex(returnedId);
-    peerPubKeys[idHex] = pubKeyDER;
+        more = false;
+        if (paged ? !readMessagePage(hdr.payloadSize, more)
+                  : !readMessageEntries(hdr.payloadSize)) {
+            return;
+        }
+    }
+}
 
-    std::cout << "Public key for " << username << " (" << idHex << "):\n"
-              << toHex(pubKeyDER) << "\n";
+bool Client::readMessagePage(uint64_t payloadSize, bool& more) {
+    // 2105 / 2109: [1 morePending] + entries
+    if (payloadSize < 1) {
+        std::cerr << "Malformed messages payload\n";
+        return false;
+    }
+    uint8_t flag = 0;
+    connection->readChunk(&flag, 1);
+    more = flag != 0;
+    return readMessageEntries(payloadSize - 1);
 }
 
-void Client::requestWaitingMessages() {
-    auto req  = ProtocolBuilder::buildFetchMessagesRequest(clientId);
-    auto resp = ProtocolParser::parse(connection->sendAndReceive(req));
-    if (resp.code != 2104) {
-        std::cout << "server responded with an error\n";
+void Client::waitForMessages() {
+    // Long polls (609) back to back until the chosen time is up: the server
+    // answers as soon as something is queued for us, so messages show up
+    // about one network hop after they are sent, without a stream of 604s
+    std::cout << "Wait for how many seconds? ";
+    unsigned seconds = 0;
+    if (!(std::cin >> seconds) || seconds == 0) {
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        std::cerr << "Invalid duration.\n";
+        return;
+    }
+    if (!serverSupportsLongPoll) {
+        requestWaitingMessages();
         return;
     }
+    std::cout << "Waiting " << seconds << " s for messages...\n";
+
+    using Clock = std::chrono::steady_clock;
+    auto deadline = Clock::now() + std::chrono::seconds(seconds);
+    for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        if (left.count() <= 0) break;
+        auto timeoutMs = static_cast<uint32_t>(std::min<int64_t>(left.count(), LONG_POLL_MS));
+
+        RequestScope scope(609);
+        auto req = ProtocolBuilder::buildWaitMessagesRequest(clientId, timeoutMs,
+                                                             fetchPageBytes, fetchPageCount);
+        auto hdr = ProtocolParser::parseHeader(connection->requestStream(req).data());
+        if (hdr.code != 2109) {
+            PooledBuffer discard(hdr.payloadSize);
+            connection->readChunk(discard.data(), discard.size());
+            if (hdr.code == 9000) {
+                // Server predates 609 – a plain fetch is all we can do
+                serverSupportsLongPoll = false;
+                std::cout << "Server can't hold requests open; fetching instead.\n";
+                requestWaitingMessages();
+                return;
+            }
+            std::cout << "server responded with an error\n";
+            return;
+        }
+        bool more = false;
+        if (!readMessagePage(hdr.payloadSize, more)) {
+            return;
+        }
+        // with more pending the next poll returns at once
+    }
+    std::cout << "Done waiting.\n";
+}
 
-    size_t i = 0;
-    while (i < resp.payload.size()) {
+bool Client::readMessageEntries(uint64_t remaining) {
+    uint8_t  entryHead[ProtocolParser::MESSAGE_ENTRY_HEADER_SIZE];
+    std::vector<FetchedMessage> batch;   // non-file entries awaiting decryption
+    while (remaining > 0) {
         // --- Parse fixed fields ---
-        std::vector<uint8_t> fromId(resp.payload.begin() + i, resp.payload.begin() + i + 16);
-        i += 16;
-
-        uint32_t msgId =  resp.payload[i] | (resp.payload[i+1] << 8)
-                          | (resp.payload[i+2] << 16) | (resp.payload[i+3] << 24);
-        i += 4;
-
-        uint8_t type = resp.payload[i++];
+        if (remaining < sizeof(entryHead)) {
+            decodeBatch(batch);
+            connection->abortStream();
+            std::cerr << "Malformed messages payload\n";
+            return false;
+        }
+        connection->readChunk(entryHead, sizeof(entryHead));
+        remaining -= sizeof(entryHead);
+
+        auto entry = ProtocolParser::parseMessageEntryHeader(entryHead);
+        if (entry.size > remaining) {
+            decodeBatch(batch);
+            connection->abortStream();
+            std::cerr << "Malformed messages payload\n";
+            return false;
+        }
+        remaining -= entry.size;
+
+        // Only texts and files may carry the compressed flag; on anything
+        // else the full type byte is kept, which prints as unknown
+        bool    compressed = (entry.type & wire::MSG_COMPRESSED) != 0;
+        uint8_t type       = entry.type & wire::MSG_TYPE_MASK;
+        if (compressed && type != 3 && type != 4) {
+            compressed = false;
+            type       = entry.type;
+        }
 
-        uint32_t len = resp.payload[i] | (resp.payload[i+1] << 8)
-                       | (resp.payload[i+2] << 16) | (resp.payload[i+3] << 24);
-        i += 4;
+        if (type == 4) { // File message (bonus) – decrypted to disk as it arrives
+            // Everything before it must be shown (and its keys installed) first
+            decodeBatch(batch);
+            printMessageHeader(entry.fromId);
+            receiveFileMessage(entry.fromId, entry.size, compressed);
+            std::cout << "-----<EOM>-----\n\n";
+            continue;
+        }
 
-        std::vector<uint8_t> content(resp.payload.begin() + i, resp.payload.begin() + i + len);
-        i += len;
+        FetchedMessage msg;
+        msg.sender     = entry.fromId;
+        msg.type       = type;
+        msg.compressed = compressed;
+        msg.content   = BufferPool::shared().acquire(entry.size);
+        connection->readChunk(msg.content.data(), msg.content.size());
+        batch.push_back(std::move(msg));
 
-        std::string senderHex = toHex(fromId);
-        const std::string& who = idToName.count(senderHex) ? idToName[senderHex] : senderHex;
+        if (batch.size() >= DECODE_BATCH_MAX) {
+            decodeBatch(batch);
+        }
+    }
+    decodeBatch(batch);
+    return true;
+}
 
-        // --- Unified output format ---
-        std::cout << "From: " << who << "\n";
-        std::cout << "Content:\n";
+void Client::decodeBatch(std::vector<FetchedMessage>& batch) {
+    // Decrypts a run of non-file messages on the worker pool and prints them
+    // in their original order. Keys follow message order: a type-2 key only
+    // applies to messages from that sender that come after it.
+
+    // 1) unwrap every type-2 / type-5 key (RSA) in parallel
+    workers.parallelFor(batch.size(), [&](size_t i) {
+        auto& m = batch[i];
+        try {
+            if (m.type == 2) {
+                m.plain = crypto.decryptRSA(m.content);
+                m.ok    = true;
+            } else if (m.type == 5) {
+                auto g = ProtocolParser::parseGroupKeyContent(
+                        ByteView(m.content.data(), m.content.size()));
+                m.plain         = crypto.decryptRSA(g.encryptedKey);
+                m.group.id      = g.groupId;
+                m.group.name    = std::move(g.name);
+                m.group.members = std::move(g.members);
+                m.groupId       = g.groupId;
+                m.ok            = true;
+            }
+        } catch (...) {}
+    });
+
+    // 2) walk in order: install keys, and bind each text to the AES context
+    //    that is current at its position (type 6 uses the group's key)
+    for (auto& m : batch) {
+        if (m.type == 2 && m.ok) {
+            installSymKey(m.sender, m.plain);
+        } else if (m.type == 5 && m.ok) {
+            m.rejected = !acceptGroupKey(m.sender, m.group);
+            if (!m.rejected) installGroup(m.group, m.plain);
+        } else if (m.type == 3) {
+            m.session = sessionFor(m.sender);
+        } else if (m.type == 6 && m.content.size() >= ClientId::SIZE) {
+            // Only a group's own key; a peer ID here must not select a peer key
+            m.groupId = ClientId(m.content.data());
+            if (groups.contains(m.groupId)) m.session = sessionFor(m.groupId);
+        }
+    }
 
-        if (type == 1) {
+    // 3) decrypt texts (AES) in parallel; a group text follows its 16-byte group ID
+    workers.parallelFor(batch.size(), [&](size_t i) {
+        auto& m = batch[i];
+        if ((m.type != 3 && m.type != 6) || !m.session) return;
+        size_t skip = m.type == 6 ? ClientId::SIZE : 0;
+        try {
+            m.plain = crypto.aesCBCDecrypt(m.content.data() + skip,
+                                           m.content.size() - skip, *m.session);
+            if (m.compressed) {
+                auto packed = std::move(m.plain);
+                m.plain = crypto.inflate(packed.data(), packed.size(), INFLATE_TEXT_MAX);
+                BufferPool::shared().release(std::move(packed));
+            }
+            m.ok    = true;
+        } catch (...) {}
+    });
+
+    // 4) print in original order
+    for (const auto& m : batch) {
+        printMessageHeader(m.sender);
+        if (m.type == 1) {
             // Symmetric key request
             std::cout << "Request for symmetric key\n";
-        }
-        else if (type == 2) {
+        } else if (m.type == 2) {
             // Symmetric key received
-            try {
-                symKeyStore[senderHex] = crypto.decryptRSA(content);
-                std::cout << "symmetric key received\n";
-            } catch (...) {
+            std::cout << (m.ok ? "symmetric key received" : "can't decrypt message") << "\n";
+        } else if (m.type == 3) { // Text message
+            if (m.ok) {
+                std::cout << std::string(m.plain.begin(), m.plain.end()) << "\n";
+            } else {
                 std::cout << "can't decrypt message\n";
             }
-        }
-        else if (type == 3) { // Text message
-            auto it = symKeyStore.find(senderHex);
-            if (it == symKeyStore.end()) {
-                std::cout << "can't decrypt message\n";
+        } else if (m.type == 5) { // Group key (invitation)
+            if (m.rejected) {
+                std::cout << "group key rejected (sender not a member, or not a group ID)\n";
+            } else if (m.ok) {
+                std::cout << "group key received for " << groupName(m.groupId) << "\n";
             } else {
-                try {
-                    auto plain = crypto.aesCBCDecrypt(content, it->second);
-                    std::cout << std::string(plain.begin(), plain.end()) << "\n";
-                } catch (...) {
-                    std::cout << "can't decrypt message\n";
-                }
-            }
-        }
-        else if (type == 4) { // File message (bonus)
-            auto it = symKeyStore.find(senderHex);
-            if (it == symKeyStore.end()) {
                 std::cout << "can't decrypt message\n";
+            }
+        } else if (m.type == 6) { // Group text message
+            if (m.ok) {
+                std::cout << "[" << groupName(m.groupId) << "] "
+                          << std::string(m.plain.begin(), m.plain.end()) << "\n";
             } else {
-                try {
-                    auto plain = crypto.aesCBCDecrypt(content, it->second);
-                    auto tmp   = std::filesystem::temp_directory_path();
-                    std::string fname = (tmp / ("msgu_" + senderHex + ".bin")).string();
-                    std::ofstream(fname, std::ios::binary)
-                            .write(reinterpret_cast<char*>(plain.data()), plain.size());
-                    std::cout << fname << "\n";
-                } catch (...) {
-                    std::cout << "can't decrypt message\n";
-                }
+                std::cout << "can't decrypt message\n";
             }
         } else {
             std::cout << "[unknown message type]\n";
         }
-
         std::cout << "-----<EOM>-----\n\n";
     }
+
+    // Contents and plaintexts go back to the pool for the next batch
+    auto& pool = BufferPool::shared();
+    for (auto& m : batch) {
+        pool.release(std::move(m.content));
+        pool.release(std::move(m.plain));
+    }
+    batch.clear();
+}
+
+void Client::printMessageHeader(const ClientId& sender) {
+    // --- Unified output format ---
+    const std::string* name = idToName.find(sender);
+    std::cout << "From: " << (name ? *name : sender.hex()) << "\n";
+    std::cout << "Content:\n";
+}
+
+void Client::receiveFileMessage(const ClientId& sender, uint32_t size, bool compressed) {
+    // Pipes `size` bytes of ciphertext from the socket through an incremental
+    // decryptor (and inflater, for compressed files) into msgu_<sender>.bin,
+    // streamChunkSize bytes at a time. The bytes are always consumed, even
+    // when they can't be decrypted; output past INFLATE_FILE_MAX fails the
+    // file.
+    auto tmp = std::filesystem::temp_directory_path();
+    std::string fname = (tmp / ("msgu_" + sender.hex() + ".bin")).string();
+
+    std::ofstream out;
+    std::unique_ptr<AESStream> dec;
+    uint64_t written  = 0;
+    bool     tooLarge = false;
+    const auto* key = findSymKey(sender);
+    bool ok = key != nullptr;
+    if (ok) {
+        out.open(fname, std::ios::binary);
+        ok = out.good();
+        dec = crypto.aesCBCDecryptStream(*key, [&](const uint8_t* data, size_t n) {
+            if (tooLarge || written + n > INFLATE_FILE_MAX) {
+                tooLarge = true;
+                return;
+            }
+            written += n;
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(n));
+        }, compressed);
+    }
+
+    PooledBuffer chunk(std::min<size_t>(streamChunkSize, size));
+    size_t left = size;
+    while (left > 0) {
+        size_t n = std::min(chunk.size(), left);
+        connection->readChunk(chunk.data(), n);
+        left -= n;
+        if (!ok) continue;
+        try {
+            dec->put(chunk.data(), n);
+        } catch (...) {
+            ok = false;
+        }
+        ok = ok && !tooLarge;
+    }
+    if (ok) {
+        try {
+            dec->finish();
+        } catch (...) {
+            ok = false;
+        }
+        ok = ok && !tooLarge;
+    }
+
+    if (out.is_open()) {
+        out.close();
+        ok = ok && out.good();
+        if (!ok) {
+            std::error_code ec;
+            std::filesystem::remove(fname, ec);
+        }
+    }
+    if (tooLarge) {
+        std::cout << "file inflates past " << INFLATE_FILE_MAX << " bytes, discarded\n";
+        return;
+    }
+    std::cout << (ok ? fname : std::string("can't decrypt message")) << "\n";
 }
 
 
@@ -327,10 +844,10 @@ void Client::requestSymmetricKey() {
 
     // 3) Build & send the "request sym key" message
     auto req = ProtocolBuilder::buildRequestSymKey(clientId, targetId);
-    auto raw = connection->sendAndReceive(req);
+    const auto& raw = connection->sendAndReceiveView(req);
 
     // 4) Parse and check response
-    auto resp = ProtocolParser::parse(raw);
+    auto resp = ProtocolParser::parseView(raw);
     if (resp.code != 2103) {
         std::cerr << "Symmetric-key request failed, server code="
                   << resp.code << "\n";
@@ -342,6 +859,7 @@ void Client::requestSymmetricKey() {
 
 
 void Client::sendSymmetricKey() {
+    RequestScope scope(603);
     // 1. Prompt for recipient username
     std::cout << "Enter recipient username: ";
     std::string username;
@@ -352,24 +870,19 @@ void Client::sendSymmetricKey() {
     }
     auto targetId = clientsMap[username];
 
-    // 2. Request peer’s public key (code 602)
-    auto reqPub = ProtocolBuilder::buildGetPublicKeyRequest(clientId, targetId);
-    auto rawPubResp = connection->sendAndReceive(reqPub);
-    auto pubResp = ProtocolParser::parse(rawPubResp);
-    if (pubResp.code != 2102) {
+    // 2. Peer’s public key – from the cache, or fetched from the server
+    ensurePublicKeys({ targetId });
+    if (!findPublicKey(targetId)) {
         std::cout << "server responded with an error\n";
         return;
     }
-    // Extract DER‐encoded public key (skip 16‐byte header)
-    std::vector<uint8_t> peerPubDER(pubResp.payload.begin() + 16, pubResp.payload.end());
 
     // 3. Generate AES key and store it
     auto symKey = crypto.generateAESKey();
-    std::string hexId = toHex(targetId);
-    symKeyStore[hexId] = symKey;
+    installSymKey(targetId, symKey);
 
-    // 4. Encrypt AES key with peer’s RSA public key
-    auto encSymKey = crypto.encryptRSA(symKey, peerPubDER);
+    // 4. Encrypt AES key with peer’s RSA public key (decoded key is cached)
+    auto encSymKey = crypto.encryptRSAFor(targetId, symKey);
 
     if (encSymKey.empty()) {
         std::cerr << "Error: encryptedSymKey is empty, aborting send.\n";
@@ -384,8 +897,8 @@ void Client::sendSymmetricKey() {
     );
 
     // 6. Send and receive in one shot
-    auto rawResp = connection->sendAndReceive(reqBytes);
-    auto resp    = ProtocolParser::parse(rawResp);
+    const auto& rawResp = connection->sendAndReceiveView(reqBytes);
+    auto resp    = ProtocolParser::parseView(rawResp);
     if (resp.code != 2103) {
         std::cout << "server responded with an error\n";
         return;
@@ -397,6 +910,7 @@ void Client::sendSymmetricKey() {
 
 void Client::sendTextMessage()
 {
+    RequestScope scope(603);
     /* 1. choose recipient */
     std::cout << "Enter recipient username: ";
     std::string username;
@@ -407,34 +921,51 @@ void Client::sendTextMessage()
         return;
     }
     auto  targetId = clientsMap[username];
-    auto  hexId    = toHex(targetId);
 
     /* 2. read plaintext */
     std::cout << "Enter message: ";
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     std::string text;
     std::getline(std::cin, text);
-    std::vector<uint8_t> plainBytes(text.begin(), text.end());
 
-    /* 3. fetch symmetric key */
-    auto it = symKeyStore.find(hexId);
-    if (it == symKeyStore.end()) {
+    /* 3. fetch the peer's cached AES context */
+    auto session = sessionFor(targetId);
+    if (!session) {
         std::cerr << "No symmetric key for " << username
                   << ".  Request one first.\n";
         return;
     }
-    const auto& symKey = it->second;
 
-    /* 4. encrypt (IV = 0 internally) */
-    auto cipher = crypto.aesCBCEncrypt(plainBytes, symKey);
+    /* 4. deflate if enabled and worth it */
+    const auto* plain = reinterpret_cast<const uint8_t*>(text.data());
+    std::vector<uint8_t> packed;
+    bool compressed = false;
+    if (compressPayloads && serverSupportsCompression && text.size() >= COMPRESS_MIN_BYTES) {
+        packed     = crypto.deflate(plain, text.size());
+        compressed = packed.size() <= text.size() * (1.0 - COMPRESS_MIN_SAVING);
+    }
 
-    /* 5. build & send request */
-    auto request     =
-            ProtocolBuilder::buildSendTextRequest(clientId, targetId, cipher);
-    auto rawResponse = connection->sendAndReceive(request);
-    auto resp        = ProtocolParser::parse(rawResponse);
+    /* 5. encrypt (IV = 0 internally), build & send request */
+    uint16_t code = 0;
+    for (;;) {
+        auto cipher = compressed
+                ? crypto.aesCBCEncrypt(packed.data(), packed.size(), *session)
+                : crypto.aesCBCEncrypt(plain, text.size(), *session);
+        auto request = ProtocolBuilder::buildSendTextRequest(clientId, targetId, cipher, compressed);
+        code = ProtocolParser::parseView(connection->sendAndReceiveView(request)).code;
+        BufferPool::shared().release(std::move(cipher));
+
+        if (code == 9000 && compressed) {
+            // Server predates compressed messages – resend as is
+            serverSupportsCompression = false;
+            compressed = false;
+            continue;
+        }
+        break;
+    }
+    BufferPool::shared().release(std::move(packed));
 
-    if (resp.code != 2103) {
+    if (code != 2103) {
         std::cout << "server responded with an error\n";
         return;
     }
@@ -443,6 +974,7 @@ void Client::sendTextMessage()
 
 
 void Client::sendFileMessage() {
+    RequestScope scope(603);
     std::cout << "Enter recipient username: ";
     std::string user; std::cin >> user;
     if (!clientsMap.count(user)) {
@@ -450,30 +982,339 @@ void Client::sendFileMessage() {
         return;
     }
     auto targetId = clientsMap[user];
-    std::string hexId = toHex(targetId);
 
-    if (!symKeyStore.count(hexId)) {
+    const auto* storedKey = findSymKey(targetId);
+    if (!storedKey) {
         std::cerr << "No symmetric key – request one first.\n";
         return;
     }
-    auto symKey = symKeyStore[hexId];
+    const auto& symKey = *storedKey;
 
     std::cout << "Enter file path: ";
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     std::string path; std::getline(std::cin, path);
     std::ifstream in(path, std::ios::binary);
-    if (!in) {
+    std::error_code ec;
+    uint64_t plainSize = std::filesystem::file_size(path, ec);
+    if (!in || ec) {
         std::cout << "file not found\n";
         return;
     }
-    std::vector<uint8_t> bytes{ std::istreambuf_iterator<char>(in), {} };
 
-    auto cipher = crypto.aesCBCEncrypt(bytes, symKey); // IV = 0
-    auto req = ProtocolBuilder::buildSendFileRequest(clientId, targetId, cipher);
-    auto resp = ProtocolParser::parse(connection->sendAndReceive(req));
+    // Opt-in compression, when a sample of the file shrinks enough
+    if (compressPayloads && serverSupportsCompression && plainSize >= COMPRESS_MIN_BYTES &&
+        sampleCompresses(in)) {
+        uint16_t code = sendFileCompressed(targetId, symKey, in, plainSize);
+        if (code != 9000) {
+            if (code != 0 && code != 2103) {
+                std::cout << "server responded with an error\n";
+            }
+            return;
+        }
+        // Server predates compressed messages – send the file as is
+        serverSupportsCompression = false;
+        in.clear();
+        in.seekg(0);
+    }
+
+    // CBC output size is known up front, so the header can go out first and
+    // the file is encrypted and sent one chunk at a time behind it
+    uint64_t cipherSize = CryptoManager::aesCBCCipherLength(plainSize);
+    if (cipherSize + 21 > UINT32_MAX) {
+        std::cerr << "File too large for the protocol.\n";
+        return;
+    }
+
+    auto head = ProtocolBuilder::buildSendFileHead(clientId, targetId,
+                                                   static_cast<uint32_t>(cipherSize));
+    try {
+        connection->beginStream(head);
+        auto enc = crypto.aesCBCEncryptStream(symKey, [this](const uint8_t* data, size_t size) {
+            connection->streamChunk(data, size);
+        });
+
+        PooledBuffer chunk(streamChunkSize);
+        uint64_t sent = 0;
+        while (in) {
+            in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+            auto got = static_cast<size_t>(in.gcount());
+            if (got == 0) break;
+            enc->put(chunk.data(), got);
+            sent += got;
+        }
+        if (sent != plainSize) {
+            throw std::runtime_error("file changed while it was being sent");
+        }
+        enc->finish();
+    } catch (const std::exception& e) {
+        connection->abortStream();
+        std::cerr << "File send failed: " << e.what() << "\n";
+        return;
+    }
+
+    auto resp = ProtocolParser::parseView(connection->finishStream());
     if (resp.code != 2103) {
         std::cout << "server responded with an error\n";
         return;
     }
 }
 
+
+bool Client::sampleCompresses(std::istream& in) {
+    // The head of the file, deflated at the fastest level: already-compressed
+    // formats (archives, images, video) are recognised here and sent as is
+    PooledBuffer sample(COMPRESS_SAMPLE_BYTES);
+    in.read(reinterpret_cast<char*>(sample.data()), static_cast<std::streamsize>(sample.size()));
+    auto got = static_cast<size_t>(in.gcount());
+    in.clear();
+    in.seekg(0);
+    if (got == 0) return false;
+
+    auto packed = crypto.deflate(sample.data(), got, 1);
+    bool worth  = packed.size() <= got * (1.0 - COMPRESS_MIN_SAVING);
+    BufferPool::shared().release(std::move(packed));
+    return worth;
+}
+
+
+uint16_t Client::sendFileCompressed(const ClientId& targetId, const std::vector<uint8_t>& symKey,
+                                    std::istream& in, uint64_t plainSize) {
+    // The compressed size is only known at the end, but the 603 header
+    // carries it up front: deflate + encrypt into a temp file, then stream
+    // that. Memory use stays at one chunk either way.
+    auto spoolPath = std::filesystem::temp_directory_path() /
+                     ("msgu_spool_" + targetId.hex() + ".bin");
+    struct SpoolGuard {
+        std::filesystem::path path;
+        ~SpoolGuard() { std::error_code ec; std::filesystem::remove(path, ec); }
+    } guard{ spoolPath };
+
+    uint64_t cipherSize = 0;
+    try {
+        std::ofstream spool(spoolPath, std::ios::binary | std::ios::trunc);
+        if (!spool) {
+            throw std::runtime_error("cannot create " + spoolPath.string());
+        }
+        auto enc = crypto.aesCBCEncryptStream(symKey, [&spool, &cipherSize](const uint8_t* data, size_t n) {
+            spool.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(n));
+            cipherSize += n;
+        }, true);
+
+        PooledBuffer chunk(streamChunkSize);
+        uint64_t read = 0;
+        while (in) {
+            in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+            auto got = static_cast<size_t>(in.gcount());
+            if (got == 0) break;
+            enc->put(chunk.data(), got);
+            read += got;
+        }
+        if (read != plainSize) {
+            throw std::runtime_error("file changed while it was being sent");
+        }
+        enc->finish();
+        spool.close();
+        if (!spool) {
+            throw std::runtime_error("write to " + spoolPath.string() + " failed");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Compression failed: " << e.what() << "\n";
+        return 0;
+    }
+    if (cipherSize + wire::MessageBody::SIZE > UINT32_MAX) {
+        std::cerr << "File too large for the protocol.\n";
+        return 0;
+    }
+
+    auto head = ProtocolBuilder::buildSendFileHead(clientId, targetId,
+                                                   static_cast<uint32_t>(cipherSize), true);
+    try {
+        std::ifstream body(spoolPath, std::ios::binary);
+        connection->beginStream(head);
+
+        PooledBuffer chunk(streamChunkSize);
+        uint64_t sent = 0;
+        while (sent < cipherSize) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(chunk.size(), cipherSize - sent));
+            body.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(want));
+            auto got = static_cast<size_t>(body.gcount());
+            if (got == 0) {
+                throw std::runtime_error("spool file truncated");
+            }
+            connection->streamChunk(chunk.data(), got);
+            sent += got;
+        }
+    } catch (const std::exception& e) {
+        connection->abortStream();
+        std::cerr << "File send failed: " << e.what() << "\n";
+        return 0;
+    }
+    return ProtocolParser::parseView(connection->finishStream()).code;
+}
+
+
+void Client::toggleCompression() {
+    compressPayloads = !compressPayloads;
+    std::cout << "Compression of texts and files "
+              << (compressPayloads ? "enabled" : "disabled") << ".\n";
+    if (compressPayloads) {
+        std::cout << "Recipients need a client that understands compressed messages.\n";
+    }
+}
+
+
+void Client::createGroup() {
+    RequestScope scope(603);
+    // A group is a random 16-byte ID plus one AES key, handed to every member
+    // as a type-5 message wrapped with that member's RSA key. Messages to the
+    // group are then encrypted once and fanned out by the server (606).
+    std::cout << "Enter group name: ";
+    std::string name;
+    std::cin >> name;
+    if (name.size() > 255 || groupByName.count(name)) {
+        std::cerr << "Invalid or existing group name.\n";
+        return;
+    }
+
+    std::cout << "Enter member usernames: ";
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    std::string line;
+    std::getline(std::cin, line);
+    std::istringstream names(line);
+
+    Group group;
+    group.name = name;
+    group.id   = ClientId::fromVector(crypto.randomBytes(ClientId::SIZE));
+    group.members.push_back(clientId);
+
+    std::string username;
+    while (names >> username) {
+        auto it = clientsMap.find(username);
+        if (it == clientsMap.end()) {
+            std::cerr << "No such user in memory: " << username << ". Run option 120 first.\n";
+            continue;
+        }
+        if (std::find(group.members.begin(), group.members.end(), it->second)
+                == group.members.end()) {
+            group.members.push_back(it->second);
+        }
+    }
+    if (group.members.size() < 2) {
+        std::cerr << "A group needs at least one other member.\n";
+        return;
+    }
+    if (group.members.size() > GROUP_MEMBERS_MAX) {
+        std::cerr << "Too many group members (at most " << GROUP_MEMBERS_MAX - 1 << " others).\n";
+        return;
+    }
+
+    // 1) public keys of every member we don't have one for, in one round trip
+    ensurePublicKeys(std::vector<ClientId>(group.members.begin() + 1, group.members.end()));
+
+    // 2) one RSA-wrapped copy of the group key per member, pipelined
+    auto key = crypto.generateAESKey();
+    size_t delivered = 0;
+    for (size_t i = 1; i < group.members.size(); ++i) {
+        const auto& memberId = group.members[i];
+        if (!crypto.hasPeerPublicKey(memberId)) {
+            std::cerr << "No public key for " << memberId.hex() << ", skipping.\n";
+            continue;
+        }
+        auto encKey = crypto.encryptRSAFor(memberId, key);
+        auto req = ProtocolBuilder::buildSendGroupKeyRequest(
+                clientId, memberId, group.id, group.name, group.members, encKey);
+        connection->submit(req, [&delivered](const std::vector<uint8_t>& raw) {
+            if (ProtocolParser::parseView(raw).code == 2103) ++delivered;
+        });
+    }
+    connection->drain();
+
+    size_t others = group.members.size() - 1;
+    installGroup(std::move(group), key);
+    std::cout << "Group " << name << " created; key delivered to "
+              << delivered << " of " << others << " members.\n";
+}
+
+
+void Client::sendGroupMessage() {
+    RequestScope scope(606);
+    std::cout << "Enter group name: ";
+    std::string name;
+    std::cin >> name;
+    auto byName = groupByName.find(name);
+    if (byName == groupByName.end()) {
+        std::cerr << "No such group.\n";
+        return;
+    }
+    const Group* group = groups.find(byName->second);
+    auto session = sessionFor(byName->second);
+    if (!group || !session) {
+        std::cerr << "No key for group " << name << ".\n";
+        return;
+    }
+
+    std::cout << "Enter message: ";
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    std::string text;
+    std::getline(std::cin, text);
+
+    // Encrypted once; the server queues the same ciphertext for every member
+    auto cipher = crypto.aesCBCEncrypt(reinterpret_cast<const uint8_t*>(text.data()),
+                                       text.size(), *session);
+
+    // The full member list, us included: the server only fans out for a
+    // sender that belongs to the group, and skips the sender itself
+    auto request = ProtocolBuilder::buildSendGroupTextRequest(clientId, group->id,
+                                                              group->members, cipher);
+    auto resp = ProtocolParser::parseView(connection->sendAndReceiveView(request));
+    BufferPool::shared().release(std::move(cipher));
+    if (resp.code != 2106) {
+        std::cout << "server responded with an error\n";
+        return;
+    }
+    std::cout << "Group message sent to " << name << ".\n";
+}
+
+
+void Client::showBufferPoolStats() {
+    auto st = BufferPool::shared().stats();
+    std::cout << "Buffer pool: " << st.acquires << " acquires, "
+              << std::fixed << std::setprecision(1) << st.hitRate() * 100.0
+              << "% reused, " << st.releases << " releases ("
+              << st.dropped << " freed)\n"
+              << "Retained: " << st.buffersRetained << " buffers, "
+              << st.bytesRetained / 1024 << " KiB\n";
+    std::cout.unsetf(std::ios::fixed);
+}
+
+
+void Client::showMetrics() {
+    if (!Metrics::ENABLED) {
+        std::cout << "Metrics are compiled out (configure with -DCLIENT_METRICS=ON).\n";
+        return;
+    }
+    Metrics::shared().print(std::cout);
+}
+
+void Client::toggleMetricsDump() {
+    if (!Metrics::ENABLED) {
+        std::cout << "Metrics are compiled out (configure with -DCLIENT_METRICS=ON).\n";
+        return;
+    }
+    auto& metrics = Metrics::shared();
+    if (metrics.dumping()) {
+        metrics.stopDump();
+        std::cout << "Periodic metrics dump stopped.\n";
+        return;
+    }
+    std::cout << "Dump interval in seconds: ";
+    unsigned seconds = 0;
+    if (!(std::cin >> seconds) || seconds == 0) {
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        std::cerr << "Invalid interval.\n";
+        return;
+    }
+    metrics.startDump(METRICS_FILE, seconds);
+    std::cout << "Writing " << METRICS_FILE << " every " << seconds << " s.\n";
+}
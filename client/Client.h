@@ -6,10 +6,15 @@
 #include <unordered_map>
 #include <memory>
 #include <filesystem>
+#include <istream>
 #include "Connection.h"
 #include "CryptoManager.h"
 #include "ProtocolBuilder.h"
 #include "ProtocolParser.h"
+#include "WorkerPool.h"
+#include "ClientId.h"
+#include "FlatHashMap.h"
+#include "KeyStore.h"
 
 class Client {
 public:
@@ -20,21 +25,61 @@ private:
     /* ─── Network & crypto ─────────────────────────── */
     std::unique_ptr<Connection> connection;
     CryptoManager               crypto;           // AES / RSA helpers
+    WorkerPool                  workers;          // parallel message decryption
 
     /* ─── Our identity ─────────────────────────────── */
-    std::vector<uint8_t> clientId;      // 16-byte ID assigned by server
-    std::string          privateKeyPEM; // RSA private key (PEM)
+    ClientId             clientId;      // assigned by server; zero until registered
+    std::string          myUsername;
+    bool                 registered = false;
     uint8_t              version = 2;   // protocol version
 
     /* ─── In-memory caches ─────────────────────────── */
-    // peer symmetric keys   (hex-ID → AES key)
-    std::unordered_map<std::string,std::vector<uint8_t>> symKeyStore;
-    // peer RSA public keys  (hex-ID → DER bytes)
-    std::unordered_map<std::string,std::vector<uint8_t>> peerPubKeys;
-    // users list            (username → client ID bytes)
-    std::unordered_map<std::string,std::vector<uint8_t>> clientsMap;
+    // peer symmetric keys   (peer / group ID → AES key)
+    FlatHashMap<ClientId,std::vector<uint8_t>>   symKeyStore;
+    // peer RSA public keys  (ID → DER bytes)
+    FlatHashMap<ClientId,std::vector<uint8_t>>   peerPubKeys;
+    // users list            (username → client ID)
+    std::unordered_map<std::string,ClientId>     clientsMap;
     // ID → name mapping for nicer printouts
-    std::unordered_map<std::string,std::string>          idToName;
+    FlatHashMap<ClientId,std::string>            idToName;
+    // registry version clientsMap reflects (608); 0 = never synced
+    uint64_t clientsListVersion      = 0;
+    bool     serverSupportsListDelta = true;   // cleared on a 9000 to 608
+
+    /* ─── Persistent keys ──────────────────────────── */
+    // On-disk copy of symKeyStore / peerPubKeys, sealed under our private
+    // key; entries are read on first use, not at startup. Null until we
+    // have an identity, or if keys.idx / keys.dat can't be opened.
+    std::unique_ptr<KeyStore> keyStore;
+
+    /* ─── Streaming ────────────────────────────────── */
+    // bytes read from disk / socket per step when streaming file content
+    size_t streamChunkSize = 64 * 1024;
+
+    /* ─── Compression (opt-in, menu 154) ───────────── */
+    // Text and file content is deflated before encryption and sent with
+    // wire::MSG_COMPRESSED set – only when it pays off: texts must shrink
+    // by COMPRESS_MIN_SAVING, files are judged on their first
+    // COMPRESS_SAMPLE_BYTES. A compressed file is spooled to a temp file
+    // first, because the header carries the ciphertext size.
+    bool compressPayloads          = false;
+    bool serverSupportsCompression = true;                 // cleared on a 9000 to a flagged 603
+    static constexpr size_t COMPRESS_MIN_BYTES    = 256;   // smaller content is sent as is
+    static constexpr size_t COMPRESS_SAMPLE_BYTES = 64 * 1024;
+    static constexpr double COMPRESS_MIN_SAVING   = 0.10;  // fraction of the size saved
+    static constexpr size_t INFLATE_TEXT_MAX      = 64 * 1024 * 1024;
+    // A received file may inflate to no more than an uncompressed 603 could
+    // carry (32-bit content size); a deflate bomb is cut off there
+    static constexpr uint64_t INFLATE_FILE_MAX    = 0xFFFFFFFFull;
+
+    /* ─── Paged fetch (605) ────────────────────────── */
+    uint32_t fetchPageBytes       = 4 * 1024 * 1024;  // budget per page
+    uint32_t fetchPageCount       = 256;              // max messages per page
+    bool     serverSupportsPaging = true;             // cleared on a 9000 to 605
+
+    /* ─── Long poll (609, menu 141) ────────────────── */
+    static constexpr uint32_t LONG_POLL_MS = 30 * 1000;   // per request; the server caps it
+    bool serverSupportsLongPoll = true;                   // cleared on a 9000 to 609
 
     /* ─── Server info ──────────────────────────────── */
     std::string serverAddress;
@@ -42,9 +87,24 @@ private:
 
     /* ─── Init & persistence ───────────────────────── */
     void readServerInfo();
-    bool checkIfRegistered();
-    void loadMeInfo();
-    void saveMeInfo(const std::string& username);
+    bool loadIdentity();   // me.bin, or import of the legacy me.info
+    void saveIdentity();
+    void openKeyStore();   // for the identity now in `crypto`
+
+    /* ─── Key management ───────────────────────────── */
+    void installSymKey(const ClientId& id, const std::vector<uint8_t>& key);
+    void installPeerPublicKey(const ClientId& id, const std::vector<uint8_t>& der);
+    // Memory first, then keyStore (a hit is installed); null if neither has it
+    const std::vector<uint8_t>* findSymKey(const ClientId& id);
+    const std::vector<uint8_t>* findPublicKey(const ClientId& id);
+    AESSessionPtr               sessionFor(const ClientId& id);
+    void addClient(const ClientRecord& rec);
+    void removeClient(const ClientId& id);
+    // Fetches whichever of `ids` are not known yet, in as few round trips as possible
+    void ensurePublicKeys(const std::vector<ClientId>& ids);
+
+    bool serverSupportsBatchKeys = true;               // cleared on a 9000 to 607
+    static constexpr size_t PUBKEY_BATCH_MAX = 1024;   // IDs per 607 request
 
     /* ─── Menu helpers ─────────────────────────────── */
     static void showMenu();
@@ -55,8 +115,63 @@ private:
     void requestClientsList();
     void requestPublicKey();
     void requestWaitingMessages();
+    void waitForMessages();
+    bool readMessageEntries(uint64_t remaining);   // false on malformed payload
+    bool readMessagePage(uint64_t payloadSize, bool& more);   // 2105 / 2109 body
+    void receiveFileMessage(const ClientId& sender, uint32_t size, bool compressed);
     void sendTextMessage();
     void requestSymmetricKey();
     void sendSymmetricKey();
     void sendFileMessage();
+    bool sampleCompresses(std::istream& in);   // rewinds `in`
+    // Deflates + encrypts `in` into a spool file, then streams it; returns the response code (0 = not sent)
+    uint16_t sendFileCompressed(const ClientId& targetId, const std::vector<uint8_t>& symKey,
+                                std::istream& in, uint64_t plainSize);
+    void toggleCompression();
+    void createGroup();
+    void sendGroupMessage();
+    static void showBufferPoolStats();
+    static void showMetrics();
+    static void toggleMetricsDump();   // JSON snapshot to METRICS_FILE every N seconds
+    static constexpr const char* METRICS_FILE = "metrics.json";
+
+    /* ─── Groups ───────────────────────────────────── */
+    struct Group {
+        ClientId              id;        // 16 random bytes
+        std::string           name;
+        std::vector<ClientId> members;   // including ours
+    };
+    // group ID → group   (its AES key lives in symKeyStore under the same ID)
+    FlatHashMap<ClientId,Group>              groups;
+    // group name → group ID
+    std::unordered_map<std::string,ClientId> groupByName;
+
+    static constexpr size_t GROUP_MEMBERS_MAX = 1024;   // including us; server's 606 limit
+
+    void        installGroup(Group group, const std::vector<uint8_t>& key);
+    // Whether a type-5 key from `sender` may install `group`: see Client.cpp
+    bool        acceptGroupKey(const ClientId& sender, const Group& group);
+    // keyStore copy of the group (and of the group list, if `added`)
+    void        persistGroup(const Group& group, bool added);
+    void        restoreGroups();   // every group in keyStore, on opening it
+    std::string groupName(const ClientId& id) const;   // hex if unknown
+
+    /* ─── Batch decoding of fetched messages ───────── */
+    struct FetchedMessage {
+        ClientId             sender;
+        uint8_t              type = 0;
+        bool                 compressed = false;   // wire::MSG_COMPRESSED was set
+        std::vector<uint8_t> content;   // as received
+        std::vector<uint8_t> plain;     // decrypted key / text
+        AESSessionPtr        session;   // key in effect at this message
+        Group                group;     // type 5: the group being joined
+        ClientId             groupId;   // types 5 / 6
+        bool                 ok = false;
+        bool                 rejected = false;   // type 5 refused by acceptGroupKey
+    };
+    // entries decoded per pool round; bounds memory and time-to-first-output
+    static constexpr size_t DECODE_BATCH_MAX = 256;
+
+    void decodeBatch(std::vector<FetchedMessage>& batch);
+    void printMessageHeader(const ClientId& sender);
 };
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// 16-byte ID as used on the wire: client IDs assigned by the server, and
+// group IDs. Trivially copyable, compared with memcmp, hashed without
+// formatting – use hex() only for display and file names.
+struct ClientId {
+    static constexpr size_t SIZE = 16;
+
+    std::array<uint8_t, SIZE> bytes{};   // all zero = "no ID" (e.g. before registration)
+
+    ClientId() = default;
+    explicit ClientId(const uint8_t* raw) { std::memcpy(bytes.data(), raw, SIZE); }
+
+    // Throws runtime_error unless `v` holds exactly SIZE bytes
+    static ClientId fromVector(const std::vector<uint8_t>& v) {
+        if (v.size() != SIZE) {
+            throw std::runtime_error("Client ID must be 16 bytes");
+        }
+        return ClientId(v.data());
+    }
+
+    const uint8_t* data()  const { return bytes.data(); }
+    static constexpr size_t size() { return SIZE; }
+    const uint8_t* begin() const { return bytes.data(); }
+    const uint8_t* end()   const { return bytes.data() + SIZE; }
+
+    bool isZero() const {
+        for (auto b : bytes) if (b) return false;
+        return true;
+    }
+
+    std::vector<uint8_t> toVector() const { return { begin(), end() }; }
+
+    // 32 lowercase hex digits
+    std::string hex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string s(2 * SIZE, '0');
+        for (size_t i = 0; i < SIZE; ++i) {
+            s[2 * i]     = digits[bytes[i] >> 4];
+            s[2 * i + 1] = digits[bytes[i] & 0x0F];
+        }
+        return s;
+    }
+
+    friend bool operator==(const ClientId& a, const ClientId& b) {
+        return std::memcmp(a.bytes.data(), b.bytes.data(), SIZE) == 0;
+    }
+    friend bool operator!=(const ClientId& a, const ClientId& b) { return !(a == b); }
+    friend bool operator<(const ClientId& a, const ClientId& b) {
+        return std::memcmp(a.bytes.data(), b.bytes.data(), SIZE) < 0;
+    }
+};
+
+// IDs are random (UUID4 / CSPRNG) but may also be chosen by a peer, so the
+// two halves are still run through a 64-bit mixer rather than used as-is
+struct ClientIdHash {
+    size_t operator()(const ClientId& id) const noexcept {
+        uint64_t lo, hi;
+        std::memcpy(&lo, id.bytes.data(), 8);
+        std::memcpy(&hi, id.bytes.data() + 8, 8);
+        uint64_t h = lo ^ (hi * 0x9E3779B97F4A7C15ULL);
+        h ^= h >> 32;
+        h *= 0xD6E8FEB86659FD93ULL;
+        h ^= h >> 32;
+        return static_cast<size_t>(h);
+    }
+};
+
+namespace std {
+template <> struct hash<ClientId> : ClientIdHash {};
+}
@@ -0,0 +1,200 @@
+#include "ClientSession.h"
+#include <stdexcept>
+#include "BufferPool.h"
+
+namespace {
+constexpr size_t INFLATE_MAX = 64 * 1024 * 1024;   // same cap as the interactive client
+}
+
+ClientSession::ClientSession(const std::string& host, int port)
+    : connection(host, port) {}
+
+ByteView ClientSession::exchange(uint16_t requestCode, const Frame& request, uint16_t expectedCode) {
+    auto t0 = std::chrono::steady_clock::now();
+    const auto& raw = connection.sendAndReceiveView(request);
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+
+    auto resp = ProtocolParser::parseView(raw);
+    lastResponseCode = resp.code;
+    if (observer) {
+        observer(requestCode, resp.code,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+    }
+    if (resp.code != expectedCode) {
+        throw std::runtime_error("Request " + std::to_string(requestCode) +
+                                 " failed, server code=" + std::to_string(resp.code));
+    }
+    return resp.payload;
+}
+
+/* ─── Identity ──────────────────────────────────── */
+
+ClientId ClientSession::registerUser(const std::string& name) {
+    crypto.generateRSAKeyPair();
+    auto pubDER  = crypto.getPublicKeyDER();
+    auto payload = exchange(600, ProtocolBuilder::buildRegisterRequest(name, pubDER), 2100);
+
+    clientId = ClientId(payload.sub(0, ClientId::SIZE).data());
+    username = name;
+    return clientId;
+}
+
+std::vector<ClientRecord> ClientSession::listClients() {
+    return ProtocolParser::parseClientList(
+            exchange(601, ProtocolBuilder::buildListRequest(clientId), 2101));
+}
+
+const std::vector<uint8_t>& ClientSession::publicKey(const ClientId& peer) {
+    if (const auto* cached = peerPubKeys.find(peer)) return *cached;
+
+    auto payload = exchange(602, ProtocolBuilder::buildGetPublicKeyRequest(clientId, peer), 2102);
+    if (payload.size() <= ClientId::SIZE) {
+        throw std::runtime_error("Malformed public key payload");
+    }
+    std::vector<uint8_t> der(payload.begin() + ClientId::SIZE, payload.end());
+    crypto.setPeerPublicKey(peer, der);
+    return peerPubKeys[peer] = std::move(der);
+}
+
+/* ─── Key exchange ──────────────────────────────── */
+
+void ClientSession::requestSymKey(const ClientId& peer) {
+    exchange(603, ProtocolBuilder::buildRequestSymKey(clientId, peer), 2103);
+}
+
+void ClientSession::sendSymKey(const ClientId& peer) {
+    publicKey(peer);
+    auto symKey    = crypto.generateAESKey();
+    auto encSymKey = crypto.encryptRSAFor(peer, symKey);
+    exchange(603, ProtocolBuilder::buildSendSymKeyRequest(clientId, peer, encSymKey), 2103);
+    // Installed only once the peer can have it
+    crypto.setSessionKey(peer, symKey);
+}
+
+bool ClientSession::hasSymKey(const ClientId& peer) const {
+    return crypto.session(peer) != nullptr;
+}
+
+/* ─── Messages ──────────────────────────────────── */
+
+void ClientSession::sendText(const ClientId& peer, const std::string& text) {
+    auto session = crypto.session(peer);
+    if (!session) throw std::runtime_error("No symmetric key for " + peer.hex());
+
+    auto cipher = crypto.aesCBCEncrypt(reinterpret_cast<const uint8_t*>(text.data()),
+                                       text.size(), *session);
+    try {
+        exchange(603, ProtocolBuilder::buildSendTextRequest(clientId, peer, cipher), 2103);
+    } catch (...) {
+        BufferPool::shared().release(std::move(cipher));
+        throw;
+    }
+    BufferPool::shared().release(std::move(cipher));
+}
+
+void ClientSession::sendFile(const ClientId& peer, const std::vector<uint8_t>& data) {
+    auto session = crypto.session(peer);
+    if (!session) throw std::runtime_error("No symmetric key for " + peer.hex());
+
+    auto cipher = crypto.aesCBCEncrypt(data.data(), data.size(), *session);
+    try {
+        exchange(603, ProtocolBuilder::buildSendFileRequest(clientId, peer, cipher), 2103);
+    } catch (...) {
+        BufferPool::shared().release(std::move(cipher));
+        throw;
+    }
+    BufferPool::shared().release(std::move(cipher));
+}
+
+std::vector<ReceivedMessage> ClientSession::fetch(uint32_t maxBytes, uint32_t maxCount, bool* more) {
+    std::vector<ReceivedMessage> out;
+    if (more) *more = false;
+
+    if (serverSupportsPaging) {
+        try {
+            auto payload = exchange(605, ProtocolBuilder::buildFetchPageRequest(
+                                            clientId, maxBytes, maxCount), 2105);
+            if (payload.empty()) throw std::runtime_error("Malformed messages payload");
+            if (more) *more = payload[0] != 0;
+            decodeEntries(payload.sub(1, payload.size() - 1), out);
+            return out;
+        } catch (const std::runtime_error&) {
+            if (lastResponseCode != 9000) throw;
+            // Server predates 605 – fetch everything with 604 from now on
+            serverSupportsPaging = false;
+        }
+    }
+    decodeEntries(exchange(604, ProtocolBuilder::buildFetchMessagesRequest(clientId), 2104), out);
+    return out;
+}
+
+std::vector<ReceivedMessage> ClientSession::wait(uint32_t timeoutMs, uint32_t maxBytes,
+                                                 uint32_t maxCount, bool* more) {
+    if (serverSupportsLongPoll) {
+        try {
+            auto payload = exchange(609, ProtocolBuilder::buildWaitMessagesRequest(
+                                            clientId, timeoutMs, maxBytes, maxCount), 2109);
+            if (payload.empty()) throw std::runtime_error("Malformed messages payload");
+            std::vector<ReceivedMessage> out;
+            if (more) *more = payload[0] != 0;
+            decodeEntries(payload.sub(1, payload.size() - 1), out);
+            return out;
+        } catch (const std::runtime_error&) {
+            if (lastResponseCode != 9000) throw;
+            serverSupportsLongPoll = false;
+        }
+    }
+    return fetch(maxBytes, maxCount, more);
+}
+
+void ClientSession::decodeEntries(ByteView entries, std::vector<ReceivedMessage>& out) {
+    // Keys follow message order, as in the interactive client: a type-2 key
+    // only applies to the sender's messages that come after it
+    const uint8_t* p   = entries.begin();
+    const uint8_t* end = entries.end();
+    while (p < end) {
+        using E = wire::MessageEntry;
+        E::Reader head(p, static_cast<size_t>(end - p));
+        uint32_t size = head.get<E::CONTENT_SIZE>();
+        if (size > static_cast<size_t>(end - head.end())) {
+            throw std::runtime_error("Malformed messages payload");
+        }
+
+        ReceivedMessage msg;
+        msg.from  = head.get<E::FROM_ID>();
+        msg.msgId = head.get<E::MSG_ID>();
+        msg.type  = head.get<E::TYPE>();
+        const uint8_t* content = head.end();
+        p = content + size;
+
+        bool    compressed = (msg.type & wire::MSG_COMPRESSED) != 0;
+        uint8_t type       = msg.type & wire::MSG_TYPE_MASK;
+        if (compressed && type != 3 && type != 4) {
+            compressed = false;
+            type       = msg.type;   // unknown type, kept as received
+        }
+
+        try {
+            if (msg.type == 2) {
+                msg.content = crypto.decryptRSA(std::vector<uint8_t>(content, content + size));
+                crypto.setSessionKey(msg.from, msg.content);
+                msg.decrypted = true;
+            } else if (type == 3 || type == 4) {
+                if (auto session = crypto.session(msg.from)) {
+                    msg.content = crypto.aesCBCDecrypt(content, size, *session);
+                    if (compressed) {
+                        auto packed = std::move(msg.content);
+                        msg.content = crypto.inflate(packed.data(), packed.size(), INFLATE_MAX);
+                        BufferPool::shared().release(std::move(packed));
+                    }
+                    msg.type      = type;
+                    msg.decrypted = true;
+                }
+            }
+        } catch (const std::exception&) {
+            msg.decrypted = false;
+        }
+        if (!msg.decrypted) msg.content.assign(content, content + size);
+        out.push_back(std::move(msg));
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ClientId.h"
+#include "Connection.h"
+#include "CryptoManager.h"
+#include "FlatHashMap.h"
+#include "ProtocolBuilder.h"
+#include "ProtocolParser.h"
+
+// One decoded entry of a fetch (605 / 604)
+struct ReceivedMessage {
+    ClientId             from;
+    uint32_t             msgId = 0;
+    uint8_t              type  = 0;
+    std::vector<uint8_t> content;        // plaintext when decrypted, otherwise as received
+    bool                 decrypted = false;
+};
+
+// Headless client: one identity and one connection, every action a plain
+// call with no prompts or console output – for tools and load tests. The
+// interactive Client keeps its own menu-driven flow.
+//
+// Identities live in memory only (nothing is written to me.bin). A session
+// is not thread-safe; use one per thread. Failures throw runtime_error,
+// including any response code other than the expected one.
+class ClientSession {
+public:
+    // Reports every request: its code, the response code and the round trip
+    using Observer = std::function<void(uint16_t requestCode, uint16_t responseCode,
+                                        std::chrono::nanoseconds elapsed)>;
+
+    ClientSession(const std::string& host, int port);
+
+    void setObserver(Observer observer) { this->observer = std::move(observer); }
+
+    // 600 – generates an RSA key pair and registers under `name`
+    ClientId registerUser(const std::string& name);
+
+    const ClientId&    id()   const { return clientId; }
+    const std::string& name() const { return username; }
+
+    // 601 – every registered client (including this one)
+    std::vector<ClientRecord> listClients();
+
+    // 602 – the peer's public key, fetched once and then cached
+    const std::vector<uint8_t>& publicKey(const ClientId& peer);
+
+    // 603 type 1 – ask a peer for a symmetric key
+    void requestSymKey(const ClientId& peer);
+
+    // 603 type 2 – generates a key for `peer`, sends it RSA-wrapped and
+    // installs it locally; texts and files to that peer use it from then on
+    void sendSymKey(const ClientId& peer);
+    bool hasSymKey(const ClientId& peer) const;
+
+    // 603 type 3 / 4 – encrypted with the peer's key (throws if none)
+    void sendText(const ClientId& peer, const std::string& text);
+    void sendFile(const ClientId& peer, const std::vector<uint8_t>& data);
+
+    // 605 – one page of waiting messages (604 if the server lacks 605).
+    // Type-2 keys are installed, texts and files decrypted with the key in
+    // effect at their position. `more` reports whether messages remain.
+    std::vector<ReceivedMessage> fetch(uint32_t maxBytes, uint32_t maxCount, bool* more = nullptr);
+
+    // 609 – like fetch, but if nothing is queued the server holds the
+    // request until a message arrives or `timeoutMs` passes (then the page
+    // is empty). Falls back to fetch if the server lacks 609.
+    std::vector<ReceivedMessage> wait(uint32_t timeoutMs, uint32_t maxBytes, uint32_t maxCount,
+                                      bool* more = nullptr);
+
+private:
+    // Sends, times and checks one request; returns the response payload
+    ByteView exchange(uint16_t requestCode, const Frame& request, uint16_t expectedCode);
+
+    void decodeEntries(ByteView entries, std::vector<ReceivedMessage>& out);
+
+    Connection    connection;
+    CryptoManager crypto;
+    Observer      observer;
+
+    ClientId    clientId;
+    std::string username;
+    uint16_t    lastResponseCode     = 0;
+    bool        serverSupportsPaging = true;   // cleared on a 9000 to 605
+    bool        serverSupportsLongPoll = true; // cleared on a 9000 to 609
+
+    FlatHashMap<ClientId, std::vector<uint8_t>> peerPubKeys;   // DER
+};
@@ -1,127 +1,264 @@
 #include "Connection.h"
-#include <iostream>
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "BufferPool.h"
+#include "ProtocolSchema.h"
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
 
-#pragma comment(lib, "ws2_32.lib")
+#ifndef CLIENT_SOCKET_SNDBUF
+#define CLIENT_SOCKET_SNDBUF 0
+#endif
+#ifndef CLIENT_SOCKET_RCVBUF
+#define CLIENT_SOCKET_RCVBUF 0
+#endif
+#ifndef CLIENT_IO_TIMEOUT_MS
+#define CLIENT_IO_TIMEOUT_MS 90000   // above the server's 60 s cap on a 609 hold
+#endif
+
+// Backend-independent part of Connection; the socket primitives live in
+// ConnectionWinsock.cpp / ConnectionEpoll.cpp.
 
 Connection::Connection(const std::string& serverIP, int serverPort)
-        : ip(serverIP), port(serverPort), sockfd(INVALID_SOCKET), initialized(false) {}
+        : ip(serverIP), port(serverPort),
+          sendBufferSize(CLIENT_SOCKET_SNDBUF),
+          recvBufferSize(CLIENT_SOCKET_RCVBUF),
+          ioTimeoutMs(CLIENT_IO_TIMEOUT_MS) {}
 
 Connection::~Connection() {
-    if (sockfd != INVALID_SOCKET) {
-        closesocket(sockfd);
+    closeSocket();
+}
+
+void Connection::setSocketBufferSizes(int sendBytes, int recvBytes) {
+    sendBufferSize = sendBytes;
+    recvBufferSize = recvBytes;
+}
+
+void Connection::setIoTimeout(int ms) {
+    ioTimeoutMs = ms > 0 ? ms : 0;
+}
+
+void Connection::setMaxInFlight(size_t window) {
+    maxInFlight = window ? window : 1;
+}
+
+void Connection::ensureConnected() {
+    if (!isOpen() && !connectToServer()) {
+        throw std::runtime_error("Unable to connect to server");
     }
-    if (initialized) {
-        WSACleanup();
+}
+
+std::vector<uint8_t> Connection::sendAndReceive(const Frame& data) {
+    return sendAndReceiveView(data);
+}
+
+const std::vector<uint8_t>& Connection::sendAndReceiveView(const Frame& data) {
+    ensureConnected();
+    drain();
+
+#if CLIENT_ENABLE_METRICS
+    uint64_t sent = Metrics::nowNs();
+#endif
+    if (!sendFrame(data)) {
+        resetPipeline();
+        throw std::runtime_error("Failed to send data");
     }
+    const auto& response = receiveResponse();
+#if CLIENT_ENABLE_METRICS
+    recordRoundTrip(lastSentCode, sent, data.size(), response.size());
+#endif
+    return response;
 }
 
-bool Connection::initializeWinsock() {
-    WSADATA wsaData;
-    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (result != 0) {
-        std::cerr << "WSAStartup failed: " << result << std::endl;
-        return false;
+void Connection::submit(const Frame& data, ResponseHandler onResponse) {
+    ensureConnected();
+    while (pending.size() >= maxInFlight) {
+        completeOldest();
     }
-    initialized = true;
-    return true;
+
+#if CLIENT_ENABLE_METRICS
+    uint64_t sent = Metrics::nowNs();
+#endif
+    if (!sendFrame(data)) {
+        resetPipeline();
+        throw std::runtime_error("Failed to send data");
+    }
+    PendingRequest request;
+    request.handler = std::move(onResponse);
+#if CLIENT_ENABLE_METRICS
+    request.code   = lastSentCode;
+    request.sentNs = sent;
+    Metrics::shared().recordBytes(lastSentCode, data.size(), 0);
+#endif
+    pending.push_back(std::move(request));
 }
 
-bool Connection::connectToServer() {
-    if (!initialized && !initializeWinsock())
-        return false;
+std::future<std::vector<uint8_t>> Connection::submit(const Frame& data) {
+    struct Slot {
+        bool                 done = false;
+        std::vector<uint8_t> response;
+    };
+    auto slot = std::make_shared<Slot>();
+
+    submit(data, [slot](const std::vector<uint8_t>& response) {
+        // Pooled copy; the caller may hand it back with BufferPool::release
+        slot->response = BufferPool::shared().acquire(response.size());
+        std::copy(response.begin(), response.end(), slot->response.begin());
+        slot->done     = true;
+    });
 
-    sockfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (sockfd == INVALID_SOCKET) {
-        std::cerr << "Failed to create socket. Error code: " << WSAGetLastError() << std::endl;
-        return false;
+    // Deferred: the caller's get() drives the connection, no reader thread needed
+    return std::async(std::launch::deferred, [this, slot] {
+        while (!slot->done) {
+            completeOldest();
+        }
+        return std::move(slot->response);
+    });
+}
+
+void Connection::beginStream(const Frame& head) {
+    ensureConnected();
+    drain();
+#if CLIENT_ENABLE_METRICS
+    streamSentNs = Metrics::nowNs();
+    streamOut    = head.size();
+#endif
+    if (!sendFrame(head)) {
+        resetPipeline();
+        throw std::runtime_error("Failed to send data");
     }
+}
 
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
-    if (inet_pton(AF_INET, ip.c_str(), &serverAddr.sin_addr) != 1) {
-        std::cerr << "Invalid IP address format: " << ip << std::endl;
-        closesocket(sockfd);
-        sockfd = INVALID_SOCKET;
-        return false;
+void Connection::streamChunk(const uint8_t* data, size_t size) {
+    if (!sendData(data, size)) {
+        resetPipeline();
+        throw std::runtime_error("Failed to send data");
     }
+#if CLIENT_ENABLE_METRICS
+    streamOut += size;
+#endif
+}
+
+const std::vector<uint8_t>& Connection::finishStream() {
+    const auto& response = receiveResponse();
+#if CLIENT_ENABLE_METRICS
+    recordRoundTrip(lastSentCode, streamSentNs, streamOut, response.size());
+#endif
+    return response;
+}
+
+void Connection::abortStream() {
+    // The server is still waiting for the rest of the body; the only way
+    // to resynchronise is a fresh connection
+    resetPipeline();
+}
+
+const std::vector<uint8_t>& Connection::requestStream(const Frame& data) {
+    ensureConnected();
+    drain();
 
-    if (connect(sockfd, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
-        std::cerr << "Connection failed. Error code: " << WSAGetLastError() << std::endl;
-        closesocket(sockfd);
-        sockfd = INVALID_SOCKET;
-        return false;
+#if CLIENT_ENABLE_METRICS
+    uint64_t sent = Metrics::nowNs();
+#endif
+    if (!sendFrame(data)) {
+        resetPipeline();
+        throw std::runtime_error("Failed to send data");
     }
 
-    std::cout << "Connected to server " << ip << ":" << port << std::endl;
-    return true;
+    using H = wire::ResponseHeader;
+    rxBuffer.resize(H::SIZE);
+    if (!receiveData(rxBuffer.data(), rxBuffer.size())) {
+        resetPipeline();
+        throw std::runtime_error("Failed to receive response header");
+    }
+#if CLIENT_ENABLE_METRICS
+    // The payload is read at the caller's pace; only the wait for the
+    // header is network time, but all advertised bytes are counted
+    recordRoundTrip(lastSentCode, sent, data.size(),
+                    H::SIZE + uint64_t{H::get<H::PAYLOAD_SIZE>(rxBuffer.data())});
+#endif
+    return rxBuffer;
 }
 
-bool Connection::sendData(const std::vector<uint8_t>& data) {
-    int totalSent = 0;
-    while (totalSent < static_cast<int>(data.size())) {
-        int sent = send(sockfd, reinterpret_cast<const char*>(data.data()) + totalSent,
-                        static_cast<int>(data.size()) - totalSent, 0);
-        if (sent == SOCKET_ERROR) {
-            std::cerr << "Send failed. Error code: " << WSAGetLastError() << std::endl;
-            return false;
-        }
-        totalSent += sent;
+void Connection::readChunk(uint8_t* buffer, size_t size) {
+    if (!receiveData(buffer, size)) {
+        resetPipeline();
+        throw std::runtime_error("Failed to receive payload");
     }
-    return true;
-}
-
-bool Connection::receiveData(std::vector<uint8_t>& buffer, size_t sizeToRead) {
-    buffer.resize(sizeToRead);
-    size_t totalReceived = 0;
-    while (totalReceived < sizeToRead) {
-        int received = recv(sockfd, reinterpret_cast<char*>(buffer.data()) + totalReceived,
-                            static_cast<int>(sizeToRead - totalReceived), 0);
-        if (received <= 0) {
-            std::cerr << "Receive failed or connection closed. Code: " << WSAGetLastError() << std::endl;
-            return false;
-        }
-        totalReceived += received;
+}
+
+bool Connection::sendData(const uint8_t* data, size_t size) {
+    IoSlice slice{ data, size };
+    return sendGather(&slice, 1);
+}
+
+bool Connection::sendFrame(const Frame& frame) {
+    IoSlice slices[Frame::MAX_PARTS];
+    size_t count = frame.gather(slices);
+#if CLIENT_ENABLE_METRICS
+    using H = wire::RequestHeader;
+    lastSentCode = count && slices[0].size >= H::SIZE ? H::get<H::CODE>(slices[0].data) : 0;
+#endif
+    return sendGather(slices, count);
+}
+
+void Connection::drain() {
+    while (!pending.empty()) {
+        completeOldest();
     }
-    return true;
 }
 
-std::vector<uint8_t> Connection::sendAndReceive(const std::vector<uint8_t>& data) {
-    if (sockfd == INVALID_SOCKET && !connectToServer()) {
-        throw std::runtime_error("Unable to connect to server");
+void Connection::completeOldest() {
+    if (pending.empty()) {
+        throw std::runtime_error("No request in flight");
     }
+    const auto& response = receiveResponse();
 
-    if (!sendData(data)) {
-        throw std::runtime_error("Failed to send data");
+    // Pop before invoking so a throwing handler leaves the queue consistent
+    PendingRequest request = std::move(pending.front());
+    pending.pop_front();
+#if CLIENT_ENABLE_METRICS
+    recordRoundTrip(request.code, request.sentNs, 0, response.size());
+#endif
+    if (request.handler) {
+        request.handler(response);
     }
+}
+
+void Connection::resetPipeline() {
+    // After an I/O failure the stream position is unknown; drop the socket
+    // so outstanding requests can't be matched to the wrong responses
+    pending.clear();
+    closeSocket();
+}
 
-    // First receive response header (7 bytes)
-    std::vector<uint8_t> header;
-    if (!receiveData(header, 7)) {
+const std::vector<uint8_t>& Connection::receiveResponse() {
+    // Header and payload land in one buffer that keeps its capacity
+    // between responses, so steady-state receives don't allocate
+    using H = wire::ResponseHeader;
+    rxBuffer.resize(H::SIZE);
+    if (!receiveData(rxBuffer.data(), H::SIZE)) {
+        resetPipeline();
         throw std::runtime_error("Failed to receive response header");
     }
 
-    // Parse payload size from header (little-endian: bytes 3–6)
-    uint32_t payloadSize = header[3] |
-                           (header[4] << 8) |
-                           (header[5] << 16) |
-                           (header[6] << 24);
+    uint32_t payloadSize = H::get<H::PAYLOAD_SIZE>(rxBuffer.data());
 
-    // Receive payload
-    std::vector<uint8_t> payload;
+    // Receive payload directly behind the header
+    rxBuffer.resize(H::SIZE + static_cast<size_t>(payloadSize));
     if (payloadSize > 0) {
-        if (!receiveData(payload, payloadSize)) {
+        if (!receiveData(rxBuffer.data() + H::SIZE, payloadSize)) {
+            resetPipeline();
             throw std::runtime_error("Failed to receive payload");
         }
     }
-
-    // Combine header + payload
-    std::vector<uint8_t> response;
-    response.reserve(7 + payloadSize);
-    response.insert(response.end(), header.begin(), header.end());
-    response.insert(response.end(), payload.begin(), payload.end());
-    return response;
+    return rxBuffer;
 }
 
+#if CLIENT_ENABLE_METRICS
+void Connection::recordRoundTrip(uint16_t code, uint64_t sentNs, uint64_t bytesOut, uint64_t bytesIn) {
+    Metrics& m = Metrics::shared();
+    m.recordPhase(code, Metrics::Phase::Network, Metrics::nowNs() - sentNs);
+    m.recordBytes(code, bytesOut, bytesIn);
+    Metrics::setRespondedRequest(code);
+}
+#endif
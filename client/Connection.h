@@ -1,28 +1,147 @@
 #pragma once
+#if !defined(CLIENT_NET_WINSOCK) && !defined(CLIENT_NET_EPOLL)
+#  ifdef _WIN32
+#    define CLIENT_NET_WINSOCK
+#  else
+#    define CLIENT_NET_EPOLL
+#  endif
+#endif
+
+#if defined(CLIENT_NET_WINSOCK)
 #include <winsock2.h>
+#endif
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include "Frame.h"
+#include "Metrics.h"
 
+// Transport backend is chosen at configure time (CLIENT_NET_BACKEND):
+//   winsock – blocking WinSock2 sockets (Windows)
+//   epoll   – non-blocking POSIX sockets (Linux); each Connection waits for
+//             readiness of its one socket on its own epoll instance. This
+//             is not a shared event loop multiplexing many connections.
+// Either way, a send / receive / connect that makes no progress for the I/O
+// timeout fails, and the connection is dropped like after any I/O error.
 class Connection {
 public:
     Connection(const std::string& serverIP, int serverPort);
     ~Connection();
 
-    // Establishes connection (init Winsock + connect socket)
+    // Establishes connection (init backend + connect socket)
     bool connectToServer();
 
+    // SO_SNDBUF / SO_RCVBUF applied on the next connect (0 = OS default)
+    void setSocketBufferSizes(int sendBytes, int recvBytes);
+
+    // Longest wait for the socket to become ready (0 = forever); applies
+    // from the next connect. Must exceed any long-poll (609) hold time.
+    void setIoTimeout(int ms);
+
+    // Messages go out as Frames: all pieces in one gather write
+    // (sendmsg / WSASend), so a payload is never copied behind its header.
+    // Frame::wrap turns an already-built buffer into a Frame.
+
     // Sends a complete message (header+payload) and receives full response
-    std::vector<uint8_t> sendAndReceive(const std::vector<uint8_t>& data);
+    std::vector<uint8_t> sendAndReceive(const Frame& data);
+
+    // Zero-copy variant: the response is read straight into the connection's
+    // reusable receive buffer. The reference is valid until the next call
+    // that receives on this connection.
+    const std::vector<uint8_t>& sendAndReceiveView(const Frame& data);
+
+    /* ─── Pipelining ───────────────────────────────── */
+    // Receives the raw response (7-byte header + payload) of a pipelined request
+    using ResponseHandler = std::function<void(const std::vector<uint8_t>& response)>;
+
+    // Sends a request without waiting for its response. The server answers
+    // strictly in order, so responses are matched to requests FIFO. When
+    // maxInFlight requests are outstanding the oldest is completed first.
+    void submit(const Frame& data, ResponseHandler onResponse);
+
+    // Same, but delivers the response through a future; get() pumps the
+    // connection until this request (and all older ones) have completed.
+    std::future<std::vector<uint8_t>> submit(const Frame& data);
+
+    // Completes every outstanding request
+    void drain();
+
+    void   setMaxInFlight(size_t window);
+    size_t inFlight() const { return pending.size(); }
+
+    /* ─── Streaming requests ───────────────────────── */
+    // For bodies too large to build in memory: beginStream drains the pipeline
+    // and sends `head` (header + fixed payload fields), the caller then pushes
+    // exactly the advertised remainder with streamChunk, and finishStream
+    // returns the response (same lifetime rules as sendAndReceiveView).
+    // abortStream drops the connection if the body cannot be completed.
+    void beginStream(const Frame& head);
+    void streamChunk(const uint8_t* data, size_t size);
+    const std::vector<uint8_t>& finishStream();
+    void abortStream();
+
+    // The reverse: requestStream sends `data` and reads only the 7-byte
+    // response header (returned); the caller then pulls exactly the
+    // advertised payload with readChunk, one bounded piece at a time.
+    const std::vector<uint8_t>& requestStream(const Frame& data);
+    void readChunk(uint8_t* buffer, size_t size);
 
 private:
-    bool initializeWinsock();
-    bool sendData(const std::vector<uint8_t>& data);
-    bool receiveData(std::vector<uint8_t>& buffer, size_t sizeToRead);
+    void ensureConnected();
+    void completeOldest();
+    void resetPipeline();
+    const std::vector<uint8_t>& receiveResponse();
+    bool isOpen() const;
+    void closeSocket();
+    bool sendData(const uint8_t* data, size_t size);
+    bool sendFrame(const Frame& frame);
+    // Backend primitive: writes all `count` pieces in order, blocking until done
+    bool sendGather(const IoSlice* parts, size_t count);
+    bool receiveData(uint8_t* buffer, size_t sizeToRead);
 
     std::string ip;
     int port;
-    SOCKET  sockfd;
+    int sendBufferSize;
+    int recvBufferSize;
+    int ioTimeoutMs;
+
+    struct PendingRequest {
+        ResponseHandler handler;
+#if CLIENT_ENABLE_METRICS
+        uint16_t        code   = 0;
+        uint64_t        sentNs = 0;
+#endif
+    };
+    std::deque<PendingRequest> pending;     // FIFO of requests awaiting a response
+    size_t                      maxInFlight = 8;
+
+    std::vector<uint8_t> rxBuffer;   // header + payload of the last response
+
+#if CLIENT_ENABLE_METRICS
+    // Network phase: send to complete response (to the response header for
+    // requestStream). The code is read from the header of the frame sent.
+    void recordRoundTrip(uint16_t code, uint64_t sentNs, uint64_t bytesOut, uint64_t bytesIn);
+
+    uint16_t lastSentCode  = 0;
+    uint64_t streamSentNs  = 0;
+    uint64_t streamOut     = 0;
+#endif
+
+#if defined(CLIENT_NET_WINSOCK)
+    bool initializeWinsock();
+
+    SOCKET  sockfd = INVALID_SOCKET;
     bool initialized = false;
-};
+#else
+    // Blocks on the epoll instance until the socket reports one of `events`;
+    // false with errno = ETIMEDOUT after ioTimeoutMs
+    bool waitForEvents(uint32_t events);
 
+    int      sockfd       = -1;
+    int      epollfd      = -1;
+    uint32_t armedEvents  = 0;
+#endif
+};
@@ -0,0 +1,180 @@
+#include "Connection.h"
+#include <iostream>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+bool Connection::isOpen() const {
+    return sockfd >= 0;
+}
+
+void Connection::closeSocket() {
+    if (epollfd >= 0) {
+        ::close(epollfd);
+        epollfd = -1;
+    }
+    if (sockfd >= 0) {
+        ::close(sockfd);
+        sockfd = -1;
+    }
+    armedEvents = 0;
+}
+
+bool Connection::waitForEvents(uint32_t events) {
+    // Re-arm only when the interest set changes (send ↔ receive)
+    if (armedEvents != events) {
+        epoll_event ev{};
+        ev.events  = events;
+        ev.data.fd = sockfd;
+        if (epoll_ctl(epollfd, EPOLL_CTL_MOD, sockfd, &ev) < 0) {
+            std::cerr << "epoll_ctl failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        armedEvents = events;
+    }
+
+    // The timeout covers the whole wait, across EINTR restarts
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ioTimeoutMs);
+    epoll_event ready{};
+    while (true) {
+        int timeout = -1;
+        if (ioTimeoutMs > 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+            timeout = left > 0 ? static_cast<int>(left) : 0;
+        }
+        int n = epoll_wait(epollfd, &ready, 1, timeout);
+        if (n > 0) break;
+        if (n == 0) {
+            errno = ETIMEDOUT;   // reported by the caller
+            return false;
+        }
+        if (errno != EINTR) {
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    // EPOLLERR / EPOLLHUP are reported by the following send/recv call
+    return true;
+}
+
+bool Connection::connectToServer() {
+    sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0) {
+        std::cerr << "Failed to create socket. Error: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    int noDelay = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    if (sendBufferSize > 0)
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+    if (recvBufferSize > 0)
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &recvBufferSize, sizeof(recvBufferSize));
+
+    sockaddr_in serverAddr{};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &serverAddr.sin_addr) != 1) {
+        std::cerr << "Invalid IP address format: " << ip << std::endl;
+        closeSocket();
+        return false;
+    }
+
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events  = EPOLLOUT;
+    ev.data.fd = sockfd;
+    if (epollfd < 0 || epoll_ctl(epollfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        std::cerr << "Failed to set up epoll. Error: " << std::strerror(errno) << std::endl;
+        closeSocket();
+        return false;
+    }
+    armedEvents = EPOLLOUT;
+
+    if (::connect(sockfd, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) < 0) {
+        if (errno != EINPROGRESS || !waitForEvents(EPOLLOUT)) {
+            std::cerr << "Connection failed. Error: " << std::strerror(errno) << std::endl;
+            closeSocket();
+            return false;
+        }
+        int soError = 0;
+        socklen_t len = sizeof(soError);
+        getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &soError, &len);
+        if (soError != 0) {
+            std::cerr << "Connection failed. Error: " << std::strerror(soError) << std::endl;
+            closeSocket();
+            return false;
+        }
+    }
+
+    std::cout << "Connected to server " << ip << ":" << port << std::endl;
+    return true;
+}
+
+bool Connection::sendGather(const IoSlice* parts, size_t count) {
+    // One sendmsg over every remaining piece; after a partial write the
+    // iovec array is advanced past what the kernel took
+    iovec iov[Frame::MAX_PARTS];
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (parts[i].size == 0) continue;
+        if (n == Frame::MAX_PARTS) {
+            std::cerr << "Send failed. Error: too many pieces" << std::endl;
+            return false;
+        }
+        iov[n].iov_base = const_cast<uint8_t*>(parts[i].data);
+        iov[n].iov_len  = parts[i].size;
+        ++n;
+    }
+
+    size_t first = 0;
+    while (first < n) {
+        msghdr msg{};
+        msg.msg_iov    = iov + first;
+        msg.msg_iovlen = n - first;
+        ssize_t sent = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitForEvents(EPOLLOUT)) continue;
+            std::cerr << "Send failed. Error: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        size_t left = static_cast<size_t>(sent);
+        while (first < n && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            ++first;
+        }
+        if (left > 0) {
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    return true;
+}
+
+bool Connection::receiveData(uint8_t* buffer, size_t sizeToRead) {
+    size_t totalReceived = 0;
+    while (totalReceived < sizeToRead) {
+        ssize_t received = ::recv(sockfd, buffer + totalReceived,
+                                  sizeToRead - totalReceived, 0);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitForEvents(EPOLLIN)) continue;
+        }
+        if (received <= 0) {
+            std::cerr << "Receive failed or connection closed. Error: "
+                      << (received == 0 ? "peer closed" : std::strerror(errno)) << std::endl;
+            return false;
+        }
+        totalReceived += static_cast<size_t>(received);
+    }
+    return true;
+}
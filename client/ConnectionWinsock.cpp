@@ -0,0 +1,130 @@
+#include "Connection.h"
+#include <iostream>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+bool Connection::isOpen() const {
+    return sockfd != INVALID_SOCKET;
+}
+
+void Connection::closeSocket() {
+    if (sockfd != INVALID_SOCKET) {
+        closesocket(sockfd);
+        sockfd = INVALID_SOCKET;
+    }
+    if (initialized) {
+        WSACleanup();
+        initialized = false;
+    }
+}
+
+bool Connection::initializeWinsock() {
+    WSADATA wsaData;
+    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (result != 0) {
+        std::cerr << "WSAStartup failed: " << result << std::endl;
+        return false;
+    }
+    initialized = true;
+    return true;
+}
+
+bool Connection::connectToServer() {
+    if (!initialized && !initializeWinsock())
+        return false;
+
+    sockfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sockfd == INVALID_SOCKET) {
+        std::cerr << "Failed to create socket. Error code: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    BOOL noDelay = TRUE;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY,
+               reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    if (sendBufferSize > 0)
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF,
+                   reinterpret_cast<const char*>(&sendBufferSize), sizeof(sendBufferSize));
+    if (recvBufferSize > 0)
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF,
+                   reinterpret_cast<const char*>(&recvBufferSize), sizeof(recvBufferSize));
+    // Blocking sockets: a stalled send / recv fails with WSAETIMEDOUT
+    if (ioTimeoutMs > 0) {
+        DWORD timeout = static_cast<DWORD>(ioTimeoutMs);
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO,
+                   reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO,
+                   reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+
+    sockaddr_in serverAddr{};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &serverAddr.sin_addr) != 1) {
+        std::cerr << "Invalid IP address format: " << ip << std::endl;
+        closesocket(sockfd);
+        sockfd = INVALID_SOCKET;
+        return false;
+    }
+
+    if (connect(sockfd, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
+        std::cerr << "Connection failed. Error code: " << WSAGetLastError() << std::endl;
+        closesocket(sockfd);
+        sockfd = INVALID_SOCKET;
+        return false;
+    }
+
+    std::cout << "Connected to server " << ip << ":" << port << std::endl;
+    return true;
+}
+
+bool Connection::sendGather(const IoSlice* parts, size_t count) {
+    // One WSASend over every remaining piece; after a partial write the
+    // WSABUF array is advanced past what was taken
+    WSABUF bufs[Frame::MAX_PARTS];
+    DWORD n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (parts[i].size == 0) continue;
+        if (n == Frame::MAX_PARTS) {
+            std::cerr << "Send failed. Too many pieces" << std::endl;
+            return false;
+        }
+        bufs[n].buf = reinterpret_cast<CHAR*>(const_cast<uint8_t*>(parts[i].data));
+        bufs[n].len = static_cast<ULONG>(parts[i].size);
+        ++n;
+    }
+
+    DWORD first = 0;
+    while (first < n) {
+        DWORD sent = 0;
+        if (WSASend(sockfd, bufs + first, n - first, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+            std::cerr << "Send failed. Error code: " << WSAGetLastError() << std::endl;
+            return false;
+        }
+        while (first < n && sent >= bufs[first].len) {
+            sent -= bufs[first].len;
+            ++first;
+        }
+        if (sent > 0) {
+            bufs[first].buf += sent;
+            bufs[first].len -= sent;
+        }
+    }
+    return true;
+}
+
+bool Connection::receiveData(uint8_t* buffer, size_t sizeToRead) {
+    size_t totalReceived = 0;
+    while (totalReceived < sizeToRead) {
+        int received = recv(sockfd, reinterpret_cast<char*>(buffer) + totalReceived,
+                            static_cast<int>(sizeToRead - totalReceived), 0);
+        if (received <= 0) {
+            std::cerr << "Receive failed or connection closed. Code: " << WSAGetLastError() << std::endl;
+            return false;
+        }
+        totalReceived += received;
+    }
+    return true;
+}
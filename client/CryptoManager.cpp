@@ -1,4 +1,6 @@
 #include "CryptoManager.h"
+#include "BufferPool.h"
+#include "Metrics.h"
 #include <cryptlib.h>
 #include <osrng.h>
 #include <secblock.h>
@@ -8,40 +10,75 @@
 #include <rsa.h>
 #include <queue.h>
 #include <base64.h>
+#include <cpu.h>
+#include <zdeflate.h>
+#include <zinflate.h>
+#include <gcm.h>
+#include <sha.h>
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
 
 using namespace CryptoPP;
 
 // Zero IV for AES-CBC (16 bytes of 0)
 static const std::vector<uint8_t> ZERO_IV(AES::BLOCKSIZE, 0x00);
 
+// Uses of a thread's generator between reseeds from the OS entropy source
+static const unsigned RNG_RESEED_INTERVAL = 4096;
+
+// One long-lived generator per thread instead of a fresh AutoSeededRandomPool
+// (an entropy-source read) for every key, IV and RSA operation
+static AutoSeededRandomPool& threadRng() {
+    struct Reseeding {
+        AutoSeededRandomPool pool;
+        unsigned             uses = 0;
+    };
+    thread_local Reseeding rng;
+    if (++rng.uses >= RNG_RESEED_INTERVAL) {
+        rng.pool.Reseed();
+        rng.uses = 0;
+    }
+    return rng.pool;
+}
+
 // --- Symmetric (AES-CBC) ---
 
 std::vector<uint8_t> CryptoManager::generateAESKey() const {
-    AutoSeededRandomPool rng;
+    auto& rng = threadRng();
     SecByteBlock key(AES::DEFAULT_KEYLENGTH);
     rng.GenerateBlock(key, key.size());
     return { key.begin(), key.end() };
 }
 
 std::vector<uint8_t> CryptoManager::generateIV() const {
-    AutoSeededRandomPool rng;
+    auto& rng = threadRng();
     SecByteBlock iv(AES::BLOCKSIZE);
     rng.GenerateBlock(iv, iv.size());
     return { iv.begin(), iv.end() };
 }
 
+std::vector<uint8_t> CryptoManager::randomBytes(size_t n) const {
+    std::vector<uint8_t> out(n);
+    threadRng().GenerateBlock(out.data(), out.size());
+    return out;
+}
+
 std::vector<uint8_t> CryptoManager::aesCBCEncrypt(
         const std::vector<uint8_t>& plain,
         const std::vector<uint8_t>& key) const
 {
+    CryptoTimer timer(Metrics::Primitive::AesEncrypt, plain.size());
     CBC_Mode<AES>::Encryption enc;
     enc.SetKeyWithIV(key.data(), key.size(), ZERO_IV.data());
 
-    std::vector<uint8_t> out;
+    // Pooled storage sized for the whole ciphertext, so VectorSink never regrows it
+    std::vector<uint8_t> out = BufferPool::shared().acquire(aesCBCCipherLength(plain.size()));
+    out.clear();
     StreamTransformationFilter f(enc, new VectorSink(out));
     f.Put(plain.data(), plain.size());
     f.MessageEnd();
+    timer.setBytesOut(out.size());
     return out;
 }
 
@@ -49,24 +86,388 @@ std::vector<uint8_t> CryptoManager::aesCBCDecrypt(
         const std::vector<uint8_t>& cipher,
         const std::vector<uint8_t>& key) const
 {
+    CryptoTimer timer(Metrics::Primitive::AesDecrypt, cipher.size());
     CBC_Mode<AES>::Decryption dec;
     dec.SetKeyWithIV(key.data(), key.size(), ZERO_IV.data());
 
-    std::vector<uint8_t> out;
+    std::vector<uint8_t> out = BufferPool::shared().acquire(cipher.size());
+    out.clear();
     StreamTransformationFilter f(dec, new VectorSink(out));
     f.Put(cipher.data(), cipher.size());
     f.MessageEnd();
+    timer.setBytesOut(out.size());
     return out;
 }
 
+// --- Streaming AES-CBC ---
+
+namespace {
+// Sink that forwards whatever the filter emits to an AESStream::Output
+class CallbackSink : public Bufferless<Sink> {
+public:
+    explicit CallbackSink(const AESStream::Output& out) : out(out) {}
+
+    size_t Put2(const byte* inString, size_t length, int, bool) override {
+        if (length) out(inString, length);
+        return 0;
+    }
+
+private:
+    const AESStream::Output& out;
+};
+}
+
+struct AESStream::Impl {
+    AESStream::Output                       out;
+    std::unique_ptr<SymmetricCipher>        mode;
+    std::unique_ptr<BufferedTransformation> filter;   // head of the chain; owns the rest
+#if CLIENT_ENABLE_METRICS
+    Metrics::Primitive primitive = Metrics::Primitive::AesEncryptStream;
+    uint64_t           outBytes  = 0;   // emitted so far
+    uint64_t           outNs     = 0;   // spent in `out`, which isn't crypto time
+#endif
+};
+
+AESStream::AESStream(std::unique_ptr<Impl> impl) : impl(std::move(impl)) {}
+
+AESStream::~AESStream() = default;
+
+#if CLIENT_ENABLE_METRICS
+// Charges one put / finish to the stream's primitive, minus the output callback
+template <typename Fn>
+static void timedStreamCall(AESStream::Impl& impl, uint64_t bytesIn, Fn&& fn) {
+    uint64_t outBytes = impl.outBytes, outNs = impl.outNs;
+    CryptoTimer timer(impl.primitive, bytesIn);
+    fn();
+    timer.setBytesOut(impl.outBytes - outBytes);
+    timer.exclude(impl.outNs - outNs);
+}
+#endif
+
+void AESStream::put(const uint8_t* data, size_t size) {
+#if CLIENT_ENABLE_METRICS
+    timedStreamCall(*impl, size, [&] { impl->filter->Put(data, size); });
+#else
+    impl->filter->Put(data, size);
+#endif
+}
+
+void AESStream::finish() {
+#if CLIENT_ENABLE_METRICS
+    timedStreamCall(*impl, 0, [&] { impl->filter->MessageEnd(); });
+#else
+    impl->filter->MessageEnd();
+#endif
+}
+
+uint64_t CryptoManager::aesCBCCipherLength(uint64_t plainSize) {
+    return (plainSize / AES::BLOCKSIZE + 1) * AES::BLOCKSIZE;
+}
+
+// Chains: encrypt  [Deflator →] CBC → sink
+//         decrypt  CBC [→ Inflator] → sink
+static std::unique_ptr<AESStream::Impl> makeStreamImpl(
+        std::unique_ptr<SymmetricCipher> mode,
+        AESStream::Output out,
+        bool encrypting,
+        bool deflated)
+{
+    auto impl  = std::make_unique<AESStream::Impl>();
+    impl->mode = std::move(mode);
+#if CLIENT_ENABLE_METRICS
+    impl->primitive = encrypting ? Metrics::Primitive::AesEncryptStream
+                                 : Metrics::Primitive::AesDecryptStream;
+    impl->out = [state = impl.get(), out = std::move(out)](const uint8_t* data, size_t size) {
+        uint64_t t0 = Metrics::nowNs();
+        out(data, size);
+        state->outNs    += Metrics::nowNs() - t0;
+        state->outBytes += size;
+    };
+#else
+    impl->out  = std::move(out);
+#endif
+
+    BufferedTransformation* tail = new CallbackSink(impl->out);
+    if (deflated && !encrypting) {
+        tail = new Inflator(tail);
+    }
+    BufferedTransformation* head = new StreamTransformationFilter(*impl->mode, tail);
+    if (deflated && encrypting) {
+        head = new Deflator(head, Deflator::DEFAULT_DEFLATE_LEVEL);
+    }
+    impl->filter.reset(head);
+    return impl;
+}
+
+std::unique_ptr<AESStream> CryptoManager::aesCBCEncryptStream(
+        const std::vector<uint8_t>& key,
+        AESStream::Output out,
+        bool deflated) const
+{
+    auto enc = std::make_unique<CBC_Mode<AES>::Encryption>();
+    enc->SetKeyWithIV(key.data(), key.size(), ZERO_IV.data());
+    return std::unique_ptr<AESStream>(
+            new AESStream(makeStreamImpl(std::move(enc), std::move(out), true, deflated)));
+}
+
+std::unique_ptr<AESStream> CryptoManager::aesCBCDecryptStream(
+        const std::vector<uint8_t>& key,
+        AESStream::Output out,
+        bool deflated) const
+{
+    auto dec = std::make_unique<CBC_Mode<AES>::Decryption>();
+    dec->SetKeyWithIV(key.data(), key.size(), ZERO_IV.data());
+    return std::unique_ptr<AESStream>(
+            new AESStream(makeStreamImpl(std::move(dec), std::move(out), false, deflated)));
+}
+
+// --- Compression ---
+
+namespace {
+// VectorSink that refuses to grow past a limit (guards against inflating
+// a small message into an unbounded buffer)
+class BoundedVectorSink : public Bufferless<Sink> {
+public:
+    BoundedVectorSink(std::vector<uint8_t>& out, size_t maxSize) : out(out), maxSize(maxSize) {}
+
+    size_t Put2(const byte* inString, size_t length, int, bool) override {
+        if (length > maxSize - out.size()) {
+            throw std::runtime_error("Inflated data exceeds the size limit");
+        }
+        out.insert(out.end(), inString, inString + length);
+        return 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    size_t                maxSize;
+};
+}
+
+std::vector<uint8_t> CryptoManager::deflate(const uint8_t* data, size_t size, int level) const {
+    CryptoTimer timer(Metrics::Primitive::Deflate, size);
+    std::vector<uint8_t> out = BufferPool::shared().acquire(size / 2 + 64);
+    out.clear();
+    Deflator d(new VectorSink(out), level);
+    d.Put(data, size);
+    d.MessageEnd();
+    timer.setBytesOut(out.size());
+    return out;
+}
+
+std::vector<uint8_t> CryptoManager::inflate(const uint8_t* data, size_t size, size_t maxSize) const {
+    CryptoTimer timer(Metrics::Primitive::Inflate, size);
+    std::vector<uint8_t> out = BufferPool::shared().acquire(std::min(maxSize, 4 * size));
+    out.clear();
+    try {
+        Inflator inf(new BoundedVectorSink(out, maxSize));
+        inf.Put(data, size);
+        inf.MessageEnd();
+    } catch (const CryptoPP::Exception& e) {
+        throw std::runtime_error(std::string("Inflate failed: ") + e.what());
+    }
+    timer.setBytesOut(out.size());
+    return out;
+}
+
+// --- Authenticated encryption (AES-GCM) and hashing ---
+
+std::vector<uint8_t> CryptoManager::aesGCMEncrypt(
+        const std::vector<uint8_t>& key, const uint8_t* nonce,
+        const uint8_t* aad, size_t aadSize,
+        const uint8_t* plain, size_t size) const
+{
+    GCM<AES>::Encryption enc;
+    enc.SetKey(key.data(), key.size());
+
+    std::vector<uint8_t> out(size + GCM_TAG_SIZE);
+    enc.EncryptAndAuthenticate(out.data(), out.data() + size, GCM_TAG_SIZE,
+                               nonce, GCM_NONCE_SIZE, aad, aadSize, plain, size);
+    return out;
+}
+
+std::vector<uint8_t> CryptoManager::aesGCMDecrypt(
+        const std::vector<uint8_t>& key, const uint8_t* nonce,
+        const uint8_t* aad, size_t aadSize,
+        const uint8_t* sealed, size_t size) const
+{
+    if (size < GCM_TAG_SIZE) {
+        throw std::runtime_error("AES-GCM: input shorter than the tag");
+    }
+    GCM<AES>::Decryption dec;
+    dec.SetKey(key.data(), key.size());
+
+    size_t n = size - GCM_TAG_SIZE;
+    std::vector<uint8_t> out(n);
+    if (!dec.DecryptAndVerify(out.data(), sealed + n, GCM_TAG_SIZE,
+                              nonce, GCM_NONCE_SIZE, aad, aadSize, sealed, n)) {
+        throw std::runtime_error("AES-GCM: authentication failed");
+    }
+    return out;
+}
+
+std::vector<uint8_t> CryptoManager::sha256(const uint8_t* data, size_t size) {
+    std::vector<uint8_t> digest(SHA256::DIGESTSIZE);
+    SHA256().CalculateDigest(digest.data(), data, size);
+    return digest;
+}
+
+// --- Per-peer AES contexts ---
+
+// Keyed CBC mode objects are pooled: a caller checks one out, rewinds it to
+// the zero IV (which keeps the expanded schedule) and returns it afterwards.
+// Concurrent callers get separate objects, so CBC state is never shared.
+class AESSession {
+public:
+    explicit AESSession(const std::vector<uint8_t>& key) : key(key.data(), key.size()) {}
+
+    template <class Mode>
+    class Lease {
+    public:
+        Lease(AESSession& s, std::vector<std::unique_ptr<Mode>>& pool) : s(s), pool(pool) {
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if (!pool.empty()) {
+                    mode = std::move(pool.back());
+                    pool.pop_back();
+                }
+            }
+            if (mode) {
+                mode->Resynchronize(ZERO_IV.data());
+            } else {
+                mode = std::make_unique<Mode>();
+                mode->SetKeyWithIV(s.key.data(), s.key.size(), ZERO_IV.data());
+            }
+        }
+        ~Lease() {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            pool.push_back(std::move(mode));
+        }
+        Mode& operator*() { return *mode; }
+        Mode* operator->() { return mode.get(); }
+
+    private:
+        AESSession&                         s;
+        std::vector<std::unique_ptr<Mode>>& pool;
+        std::unique_ptr<Mode>               mode;
+    };
+
+    Lease<CBC_Mode<AES>::Encryption> encryption() { return { *this, encPool }; }
+    Lease<CBC_Mode<AES>::Decryption> decryption() { return { *this, decPool }; }
+
+private:
+    SecByteBlock                                            key;
+    std::mutex                                              mutex;
+    std::vector<std::unique_ptr<CBC_Mode<AES>::Encryption>> encPool;
+    std::vector<std::unique_ptr<CBC_Mode<AES>::Decryption>> decPool;
+};
+
+AESSessionPtr CryptoManager::setSessionKey(const ClientId& peerId,
+                                           const std::vector<uint8_t>& key) {
+    auto s = std::make_shared<AESSession>(key);
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    sessions[peerId] = s;
+    return s;
+}
+
+AESSessionPtr CryptoManager::session(const ClientId& peerId) const {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    const AESSessionPtr* s = sessions.find(peerId);
+    return s ? *s : nullptr;
+}
+
+void CryptoManager::dropSession(const ClientId& peerId) {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    sessions.erase(peerId);
+}
+
+// Same output as the StreamTransformationFilter path (PKCS#7), but without
+// building a filter chain: full blocks go straight through the cached mode.
+std::vector<uint8_t> CryptoManager::aesCBCEncrypt(
+        const uint8_t* plain, size_t size,
+        AESSession& session) const
+{
+    CryptoTimer timer(Metrics::Primitive::AesEncrypt, size);
+    const size_t full = size - size % AES::BLOCKSIZE;
+    const size_t pad  = AES::BLOCKSIZE - size % AES::BLOCKSIZE;
+
+    std::vector<uint8_t> out = BufferPool::shared().acquire(full + AES::BLOCKSIZE);
+    uint8_t last[AES::BLOCKSIZE];
+    std::memcpy(last, plain + full, size - full);
+    std::memset(last + (size - full), static_cast<int>(pad), pad);
+
+    auto enc = session.encryption();
+    if (full) enc->ProcessData(out.data(), plain, full);
+    enc->ProcessData(out.data() + full, last, AES::BLOCKSIZE);
+    timer.setBytesOut(out.size());
+    return out;
+}
+
+std::vector<uint8_t> CryptoManager::aesCBCDecrypt(
+        const uint8_t* cipher, size_t size,
+        AESSession& session) const
+{
+    CryptoTimer timer(Metrics::Primitive::AesDecrypt, size);
+    if (size == 0 || size % AES::BLOCKSIZE != 0) {
+        throw InvalidCiphertext("AES-CBC: ciphertext length is not a multiple of the block size");
+    }
+
+    std::vector<uint8_t> out = BufferPool::shared().acquire(size);
+    {
+        auto dec = session.decryption();
+        dec->ProcessData(out.data(), cipher, size);
+    }
+
+    const uint8_t pad = out.back();
+    bool valid = pad >= 1 && pad <= AES::BLOCKSIZE;
+    for (size_t i = 0; valid && i < pad; ++i) {
+        valid = out[size - 1 - i] == pad;
+    }
+    if (!valid) {
+        throw InvalidCiphertext("AES-CBC: invalid PKCS #7 block padding found");
+    }
+    out.resize(size - pad);
+    timer.setBytesOut(out.size());
+    return out;
+}
+
+// --- Build / CPU info ---
+
+std::string CryptoManager::aesImplementation() {
+    return AES::Encryption().AlgorithmProvider();
+}
+
+std::string CryptoManager::cpuFeatures() {
+    std::string features;
+    auto add = [&features](bool present, const char* name) {
+        if (!present) return;
+        if (!features.empty()) features += ' ';
+        features += name;
+    };
+#if (CRYPTOPP_BOOL_X86 || CRYPTOPP_BOOL_X32 || CRYPTOPP_BOOL_X64)
+    add(HasSSE2(),   "sse2");
+    add(HasSSSE3(),  "ssse3");
+    add(HasSSE41(),  "sse4.1");
+    add(HasSSE42(),  "sse4.2");
+    add(HasAESNI(),  "aesni");
+    add(HasCLMUL(),  "clmul");
+    add(HasSHA(),    "sha");
+    add(HasAVX2(),   "avx2");
+#endif
+    (void)add;
+    return features.empty() ? "none" : features;
+}
+
 // --- Asymmetric (RSA 1024) ---
 
 void CryptoManager::generateRSAKeyPair() {
+    CryptoTimer timer(Metrics::Primitive::RsaKeyGen, 0);
     cleanupRSA();
-    AutoSeededRandomPool rng;
     InvertibleRSAFunction params;
-    params.GenerateRandomWithKeySize(rng, 1024);
-    rsaPrivKey = new RSA::PrivateKey(params);
+    params.GenerateRandomWithKeySize(threadRng(), 1024);
+    auto priv = new RSA::PrivateKey(params);
+    rsaPrivKey   = priv;
+    rsaDecryptor = new RSAES_PKCS1v15_Decryptor(*priv);
 }
 
 std::vector<uint8_t> CryptoManager::getPublicKeyDER() const {
@@ -97,20 +498,62 @@ std::string CryptoManager::getPrivateKeyPEM() const {
     return pem;
 }
 
+std::vector<uint8_t> CryptoManager::getPrivateKeyDER() const {
+    ensureRSA();
+    auto priv = reinterpret_cast<RSA::PrivateKey*>(rsaPrivKey);
+
+    ByteQueue queue;
+    priv->DEREncodePrivateKey(queue);
+    std::vector<uint8_t> der(queue.CurrentSize());
+    queue.Get(der.data(), der.size());
+    return der;
+}
+
+void CryptoManager::loadPrivateKeyDER(const std::vector<uint8_t>& der, unsigned validationLevel) {
+    auto priv = std::make_unique<RSA::PrivateKey>();
+    try {
+        ByteQueue queue;
+        queue.Put(der.data(), der.size());
+        priv->BERDecodePrivateKey(queue, false, queue.MaxRetrievable());
+    } catch (const Exception& e) {
+        throw std::runtime_error(std::string("Stored private key is malformed: ") + e.what());
+    }
+
+    // Level 1: modulus/exponent consistency and the CRT values (dp, dq, u);
+    // level 2 also tests p, q for primality – too slow for every startup
+    if (!priv->Validate(threadRng(), validationLevel)) {
+        throw std::runtime_error("Stored private key failed validation");
+    }
+
+    cleanupRSA();
+    rsaPrivKey   = priv.get();
+    rsaDecryptor = new RSAES_PKCS1v15_Decryptor(*priv);
+    priv.release();
+}
+
+void CryptoManager::loadPrivateKeyPEM(const std::string& pem) {
+    std::string der;
+    StringSource ss(pem, true,
+                    new Base64Decoder(new StringSink(der)));
+    // Imported once into me.bin, so the full check is affordable here
+    loadPrivateKeyDER(std::vector<uint8_t>(der.begin(), der.end()), 2);
+}
+
 std::vector<uint8_t> CryptoManager::encryptRSA(
         const std::vector<uint8_t>& data,
         const std::vector<uint8_t>& pubKeyDER) const
 {
+    CryptoTimer timer(Metrics::Primitive::RsaEncrypt, data.size());
     ByteQueue queue;
     queue.Put(pubKeyDER.data(), pubKeyDER.size());
     RSA::PublicKey pub;
     pub.BERDecode(queue);
 
     RSAES_PKCS1v15_Encryptor enc(pub);
-    AutoSeededRandomPool rng;
 
     std::vector<uint8_t> cipher(enc.CiphertextLength(data.size()));
-    enc.Encrypt(rng, data.data(), data.size(), cipher.data());
+    enc.Encrypt(threadRng(), data.data(), data.size(), cipher.data());
+    timer.setBytesOut(cipher.size());
     return cipher;
 }
 
@@ -118,25 +561,88 @@ std::vector<uint8_t> CryptoManager::decryptRSA(
         const std::vector<uint8_t>& cipher) const
 {
     ensureRSA();
-    auto priv = reinterpret_cast<RSA::PrivateKey*>(rsaPrivKey);
-
-    RSAES_PKCS1v15_Decryptor dec(*priv);
-    AutoSeededRandomPool rng;
+    CryptoTimer timer(Metrics::Primitive::RsaDecrypt, cipher.size());
+    auto dec = reinterpret_cast<RSAES_PKCS1v15_Decryptor*>(rsaDecryptor);
 
-    std::vector<uint8_t> recovered(dec.MaxPlaintextLength(cipher.size()));
-    DecodingResult result = dec.Decrypt(rng,
-                                        cipher.data(), cipher.size(),
-                                        recovered.data());
+    std::vector<uint8_t> recovered(dec->MaxPlaintextLength(cipher.size()));
+    DecodingResult result = dec->Decrypt(threadRng(),
+                                         cipher.data(), cipher.size(),
+                                         recovered.data());
+    if (!result.isValidCoding) {
+        throw std::runtime_error("RSA decryption failed");
+    }
     recovered.resize(result.messageLength);
+    timer.setBytesOut(recovered.size());
     return recovered;
 }
 
+// --- Per-peer RSA public keys ---
+
+static RSA::PublicKey decodePublicKey(const std::vector<uint8_t>& der) {
+    ByteQueue queue;
+    queue.Put(der.data(), der.size());
+    RSA::PublicKey pub;
+    pub.BERDecode(queue);
+    return pub;
+}
+
+class RSAPeerKey {
+public:
+    explicit RSAPeerKey(const std::vector<uint8_t>& der)
+            : der(der), enc(decodePublicKey(der)) {}
+
+    std::vector<uint8_t>     der;   // to detect an unchanged key on refresh
+    RSAES_PKCS1v15_Encryptor enc;
+};
+
+void CryptoManager::setPeerPublicKey(const ClientId& peerId,
+                                     const std::vector<uint8_t>& pubKeyDER) {
+    {
+        std::lock_guard<std::mutex> lock(peerKeysMutex);
+        auto* cached = peerKeys.find(peerId);
+        if (cached && (*cached)->der == pubKeyDER) return;
+    }
+    auto key = std::make_shared<RSAPeerKey>(pubKeyDER);   // decode outside the lock
+    std::lock_guard<std::mutex> lock(peerKeysMutex);
+    peerKeys[peerId] = std::move(key);
+}
+
+bool CryptoManager::hasPeerPublicKey(const ClientId& peerId) const {
+    std::lock_guard<std::mutex> lock(peerKeysMutex);
+    return peerKeys.contains(peerId);
+}
+
+std::vector<uint8_t> CryptoManager::encryptRSAFor(
+        const ClientId& peerId,
+        const std::vector<uint8_t>& data) const
+{
+    std::shared_ptr<RSAPeerKey> key;
+    {
+        std::lock_guard<std::mutex> lock(peerKeysMutex);
+        auto* cached = peerKeys.find(peerId);
+        if (!cached) {
+            throw std::runtime_error("No public key cached for peer");
+        }
+        key = *cached;
+    }
+
+    CryptoTimer timer(Metrics::Primitive::RsaEncrypt, data.size());
+    std::vector<uint8_t> cipher(key->enc.CiphertextLength(data.size()));
+    key->enc.Encrypt(threadRng(), data.data(), data.size(), cipher.data());
+    timer.setBytesOut(cipher.size());
+    return cipher;
+}
+
 void CryptoManager::ensureRSA() const {
     if (!rsaPrivKey)
         throw std::runtime_error("RSA key not generated");
 }
 
 void CryptoManager::cleanupRSA() {
+    if (rsaDecryptor) {
+        delete reinterpret_cast<RSAES_PKCS1v15_Decryptor*>(rsaDecryptor);
+        rsaDecryptor = nullptr;
+    }
     if (rsaPrivKey) {
         delete reinterpret_cast<RSA::PrivateKey*>(rsaPrivKey);
         rsaPrivKey = nullptr;
@@ -2,26 +2,130 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "ClientId.h"
+#include "FlatHashMap.h"
+
+// Incremental AES-CBC (IV = 0, PKCS#7) for payloads too large to hold in
+// memory. Output is passed to the callback as soon as it is produced.
+class AESStream {
+public:
+    using Output = std::function<void(const uint8_t* data, size_t size)>;
+
+    ~AESStream();
+    void put(const uint8_t* data, size_t size);
+    // Emits the final (padded) block; throws on bad padding when decrypting
+    void finish();
+
+    struct Impl;   // Crypto++ state, opaque outside CryptoManager.cpp
+
+private:
+    friend class CryptoManager;
+    explicit AESStream(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> impl;
+};
+
+// Pre-expanded AES-CBC key schedules for one peer key (defined in
+// CryptoManager.cpp). Safe to use from several threads at once.
+class AESSession;
+using AESSessionPtr = std::shared_ptr<AESSession>;
+
+// A peer's decoded RSA public key with its ready-made encryptor (defined in
+// CryptoManager.cpp)
+class RSAPeerKey;
 
 class CryptoManager {
 public:
     // --- Symmetric (AES-CBC) ---
+    // AES outputs are drawn from BufferPool::shared(); callers in a message
+    // loop hand them back with release() once done.
     std::vector<uint8_t> generateAESKey() const;
     std::vector<uint8_t> generateIV() const;
+    std::vector<uint8_t> randomBytes(size_t n) const;   // e.g. group IDs
     std::vector<uint8_t> aesCBCEncrypt(const std::vector<uint8_t>& plain,
                                        const std::vector<uint8_t>& key) const;
 
     std::vector<uint8_t> aesCBCDecrypt(const std::vector<uint8_t>& cipher,
                                        const std::vector<uint8_t>& key) const;
 
+    // Ciphertext size for `plainSize` bytes (PKCS#7 always adds 1..16 bytes)
+    static uint64_t aesCBCCipherLength(uint64_t plainSize);
+    // With `deflated` set, the encrypt stream deflates before encrypting and
+    // the decrypt stream inflates after decrypting
+    std::unique_ptr<AESStream> aesCBCEncryptStream(const std::vector<uint8_t>& key,
+                                                   AESStream::Output out,
+                                                   bool deflated = false) const;
+    std::unique_ptr<AESStream> aesCBCDecryptStream(const std::vector<uint8_t>& key,
+                                                   AESStream::Output out,
+                                                   bool deflated = false) const;
+
+    // --- Compression (raw Deflate, applied before encryption) ---
+    // level: 1 (fastest) … 9 (smallest); output is drawn from BufferPool::shared()
+    std::vector<uint8_t> deflate(const uint8_t* data, size_t size, int level = 6) const;
+    // Throws runtime_error on corrupt input, or once the output would exceed maxSize
+    std::vector<uint8_t> inflate(const uint8_t* data, size_t size, size_t maxSize) const;
+
+    // --- Authenticated encryption (AES-GCM) and hashing ---
+    // key: 16 / 24 / 32 bytes; nonce: GCM_NONCE_SIZE bytes, never reused
+    // under one key. Output is ciphertext followed by a GCM_TAG_SIZE tag;
+    // decrypt throws runtime_error if the tag (or `aad`) doesn't match.
+    static constexpr size_t GCM_NONCE_SIZE = 12;
+    static constexpr size_t GCM_TAG_SIZE   = 16;
+    std::vector<uint8_t> aesGCMEncrypt(const std::vector<uint8_t>& key, const uint8_t* nonce,
+                                       const uint8_t* aad, size_t aadSize,
+                                       const uint8_t* plain, size_t size) const;
+    std::vector<uint8_t> aesGCMDecrypt(const std::vector<uint8_t>& key, const uint8_t* nonce,
+                                       const uint8_t* aad, size_t aadSize,
+                                       const uint8_t* sealed, size_t size) const;
+    static std::vector<uint8_t> sha256(const uint8_t* data, size_t size);
+
+    // --- Per-peer AES contexts ---
+    // The key schedule is expanded once per peer key and reused for every
+    // message; installing a new key for a peer replaces (invalidates) the old
+    // context. Holders of the old AESSessionPtr can still finish with it.
+    AESSessionPtr setSessionKey(const ClientId& peerId, const std::vector<uint8_t>& key);
+    AESSessionPtr session(const ClientId& peerId) const;   // null if none
+    void          dropSession(const ClientId& peerId);
+
+    std::vector<uint8_t> aesCBCEncrypt(const uint8_t* plain, size_t size,
+                                       AESSession& session) const;
+    std::vector<uint8_t> aesCBCDecrypt(const uint8_t* cipher, size_t size,
+                                       AESSession& session) const;
+
+    // --- Build / CPU info ---
+    // AES kernel Crypto++ dispatched to on this CPU ("AESNI", "ARMv8", "C++"…)
+    static std::string aesImplementation();
+    // SIMD extensions detected at runtime that Crypto++ can use, e.g. "aesni sse4.1 sha"
+    static std::string cpuFeatures();
+
     // --- Asymmetric (RSA 1024) ---
     void generateRSAKeyPair();
     std::vector<uint8_t> getPublicKeyDER() const;
     std::string           getPrivateKeyPEM() const;
+    std::vector<uint8_t>  getPrivateKeyDER() const;
+    // Install a stored private key (PKCS#1 DER, or its base64 as written to
+    // me.info); throws runtime_error if it doesn't validate. Level 1 checks
+    // n = p·q, d·e and the CRT values (dp, dq, u) and is cheap enough for
+    // every start; level 2 adds primality tests of p and q, which the PEM
+    // path (a one-time import of a legacy me.info) uses.
+    void loadPrivateKeyDER(const std::vector<uint8_t>& der, unsigned validationLevel = 1);
+    void loadPrivateKeyPEM(const std::string& pem);
     std::vector<uint8_t> encryptRSA(const std::vector<uint8_t>& data,
                                     const std::vector<uint8_t>& pubKeyDER) const;
     std::vector<uint8_t> decryptRSA(const std::vector<uint8_t>& cipher) const;
 
+    // --- Per-peer RSA public keys ---
+    // DER is decoded once and the encryptor kept, so repeated key exchanges
+    // with the same peer skip BER parsing and encryptor construction
+    void setPeerPublicKey(const ClientId& peerId, const std::vector<uint8_t>& pubKeyDER);
+    bool hasPeerPublicKey(const ClientId& peerId) const;
+    // Throws runtime_error if no key was set for peerId
+    std::vector<uint8_t> encryptRSAFor(const ClientId& peerId,
+                                       const std::vector<uint8_t>& data) const;
+
 
     ~CryptoManager();
 
@@ -29,5 +133,12 @@ private:
     void ensureRSA() const;
     void cleanupRSA();
 
-    void* rsaPrivKey = nullptr;
+    void* rsaPrivKey   = nullptr;
+    void* rsaDecryptor = nullptr;   // built once per private key
+
+    mutable std::mutex                   sessionsMutex;
+    FlatHashMap<ClientId, AESSessionPtr> sessions;   // peer / group ID → context
+
+    mutable std::mutex                                 peerKeysMutex;
+    FlatHashMap<ClientId, std::shared_ptr<RSAPeerKey>> peerKeys;   // peer ID → key
 };
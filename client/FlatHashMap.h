@@ -0,0 +1,147 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash map with linear probing and backward-shift deletion
+// (no tombstones). Entries live in one contiguous array, so a lookup is a
+// hash plus a short scan of neighbouring slots instead of a bucket-list
+// walk. Meant for small, cheaply hashed keys such as ClientId.
+//
+// Key and Value must be default-constructible: empty slots hold default
+// values. Pointers returned by find() / references from operator[] are
+// invalidated by any insertion or erase.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap {
+public:
+    struct Entry {
+        Key   key{};
+        Value value{};
+    };
+
+    FlatHashMap() = default;
+
+    size_t size()  const { return filled; }
+    bool   empty() const { return filled == 0; }
+
+    void clear() {
+        slots.clear();
+        used.clear();
+        filled = 0;
+    }
+
+    // Makes room for `n` entries without rehashing
+    void reserve(size_t n) {
+        size_t cap = MIN_CAPACITY;
+        while (cap * MAX_LOAD_NUM < n * MAX_LOAD_DEN) cap *= 2;
+        if (cap > slots.size()) rehash(cap);
+    }
+
+    Value* find(const Key& key) {
+        if (filled == 0) return nullptr;
+        size_t mask = slots.size() - 1;
+        for (size_t i = Hash{}(key) & mask; used[i]; i = (i + 1) & mask) {
+            if (slots[i].key == key) return &slots[i].value;
+        }
+        return nullptr;
+    }
+
+    const Value* find(const Key& key) const {
+        return const_cast<FlatHashMap*>(this)->find(key);
+    }
+
+    bool contains(const Key& key) const { return find(key) != nullptr; }
+
+    // Inserts a default Value if `key` is absent
+    Value& operator[](const Key& key) {
+        if ((filled + 1) * MAX_LOAD_DEN > slots.size() * MAX_LOAD_NUM) {
+            rehash(slots.empty() ? MIN_CAPACITY : slots.size() * 2);
+        }
+        size_t mask = slots.size() - 1;
+        size_t i = Hash{}(key) & mask;
+        for (; used[i]; i = (i + 1) & mask) {
+            if (slots[i].key == key) return slots[i].value;
+        }
+        used[i]       = 1;
+        slots[i].key  = key;
+        ++filled;
+        return slots[i].value;
+    }
+
+    bool erase(const Key& key) {
+        if (filled == 0) return false;
+        size_t mask = slots.size() - 1;
+        size_t i = Hash{}(key) & mask;
+        for (; used[i]; i = (i + 1) & mask) {
+            if (slots[i].key == key) break;
+        }
+        if (!used[i]) return false;
+
+        // Shift later members of the probe run back into the hole, so every
+        // entry stays reachable from its home slot without tombstones
+        for (size_t j = (i + 1) & mask; used[j]; j = (j + 1) & mask) {
+            size_t home = Hash{}(slots[j].key) & mask;
+            bool movable = (j > i) ? (home <= i || home > j)
+                                   : (home <= i && home > j);
+            if (movable) {
+                slots[i] = std::move(slots[j]);
+                i = j;
+            }
+        }
+        used[i]  = 0;
+        slots[i] = Entry{};
+        --filled;
+        return true;
+    }
+
+    // Iteration over occupied slots (unordered)
+    template <typename EntryT, typename MapT>
+    class Iter {
+    public:
+        Iter(MapT* m, size_t i) : map(m), pos(i) { skip(); }
+        EntryT& operator*()  const { return map->slots[pos]; }
+        EntryT* operator->() const { return &map->slots[pos]; }
+        Iter& operator++() { ++pos; skip(); return *this; }
+        bool operator!=(const Iter& o) const { return pos != o.pos; }
+        bool operator==(const Iter& o) const { return pos == o.pos; }
+    private:
+        void skip() { while (pos < map->slots.size() && !map->used[pos]) ++pos; }
+        MapT*  map;
+        size_t pos;
+    };
+    using iterator       = Iter<Entry, FlatHashMap>;
+    using const_iterator = Iter<const Entry, const FlatHashMap>;
+
+    iterator       begin()       { return { this, 0 }; }
+    iterator       end()         { return { this, slots.size() }; }
+    const_iterator begin() const { return { this, 0 }; }
+    const_iterator end()   const { return { this, slots.size() }; }
+
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+    // grow past 3/4 full; probe runs stay short at that load
+    static constexpr size_t MAX_LOAD_NUM = 3;
+    static constexpr size_t MAX_LOAD_DEN = 4;
+
+    void rehash(size_t newCapacity) {
+        std::vector<Entry>   oldSlots = std::move(slots);
+        std::vector<uint8_t> oldUsed  = std::move(used);
+        slots.assign(newCapacity, Entry{});
+        used.assign(newCapacity, 0);
+
+        size_t mask = newCapacity - 1;
+        for (size_t k = 0; k < oldSlots.size(); ++k) {
+            if (!oldUsed[k]) continue;
+            size_t i = Hash{}(oldSlots[k].key) & mask;
+            while (used[i]) i = (i + 1) & mask;
+            used[i]  = 1;
+            slots[i] = std::move(oldSlots[k]);
+        }
+    }
+
+    std::vector<Entry>   slots;   // capacity is always a power of two (or 0)
+    std::vector<uint8_t> used;    // 1 = slot holds an entry
+    size_t               filled = 0;
+};
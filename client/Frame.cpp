@@ -0,0 +1,84 @@
+#include "Frame.h"
+#include <cstring>
+#include <stdexcept>
+
+Frame Frame::wrap(const std::vector<uint8_t>& bytes) {
+    Frame f;
+    f.putBorrowed(bytes.data(), bytes.size());
+    return f;
+}
+
+Frame::Part& Frame::newPart() {
+    if (partCount == MAX_PARTS) {
+        throw std::runtime_error("Frame has too many parts");
+    }
+    Part& p = parts[partCount++];
+    p = Part{};
+    return p;
+}
+
+uint8_t* Frame::appendInline(size_t size) {
+    if (size > INLINE_CAPACITY - inlineUsed) {
+        throw std::runtime_error("Frame inline buffer overflow");
+    }
+    // Consecutive inline writes grow one piece
+    Part* p = partCount > 0 ? &parts[partCount - 1] : nullptr;
+    if (!p || p->borrowed) {
+        p = &newPart();
+        p->offset = inlineUsed;
+    }
+    uint8_t* out = inlineBytes.data() + inlineUsed;
+    inlineUsed += size;
+    p->size    += size;
+    total      += size;
+    return out;
+}
+
+void Frame::putBytes(const uint8_t* data, size_t size) {
+    std::memcpy(appendInline(size), data, size);
+}
+
+void Frame::putUint8(uint8_t v) {
+    putBytes(&v, 1);
+}
+
+void Frame::putUint16LE(uint16_t v) {
+    const uint8_t b[2] = { static_cast<uint8_t>( v        & 0xFF),
+                           static_cast<uint8_t>((v >> 8)  & 0xFF) };
+    putBytes(b, sizeof(b));
+}
+
+void Frame::putUint32LE(uint32_t v) {
+    const uint8_t b[4] = { static_cast<uint8_t>( v        & 0xFF),
+                           static_cast<uint8_t>((v >> 8)  & 0xFF),
+                           static_cast<uint8_t>((v >> 16) & 0xFF),
+                           static_cast<uint8_t>((v >> 24) & 0xFF) };
+    putBytes(b, sizeof(b));
+}
+
+void Frame::putBorrowed(const uint8_t* data, size_t size) {
+    if (size == 0) return;
+    Part& p = newPart();
+    p.borrowed = data;
+    p.size     = size;
+    total     += size;
+}
+
+size_t Frame::gather(IoSlice (&out)[MAX_PARTS]) const {
+    for (size_t i = 0; i < partCount; ++i) {
+        const Part& p = parts[i];
+        out[i] = { p.borrowed ? p.borrowed : inlineBytes.data() + p.offset, p.size };
+    }
+    return partCount;
+}
+
+std::vector<uint8_t> Frame::flatten() const {
+    IoSlice slices[MAX_PARTS];
+    size_t n = gather(slices);
+    std::vector<uint8_t> out;
+    out.reserve(total);
+    for (size_t i = 0; i < n; ++i) {
+        out.insert(out.end(), slices[i].data, slices[i].data + slices[i].size);
+    }
+    return out;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One contiguous piece of a message, as handed to a gather write
+struct IoSlice {
+    const uint8_t* data;
+    size_t         size;
+};
+
+// An outgoing message as a short list of pieces sent with one gather write
+// (sendmsg / WSASend), so nothing has to be copied to put it in one buffer:
+//   • fixed fields (header, IDs, sizes) are written into an inline buffer
+//     inside the Frame – no heap allocation;
+//   • variable-length data (names, member lists, ciphertext, keys) is
+//     borrowed by pointer and must stay alive and unchanged until the frame
+//     has been sent.
+// Inline pieces are recorded as offsets, so a Frame may be moved or copied.
+class Frame {
+public:
+    static constexpr size_t INLINE_CAPACITY = 64;   // 23-byte header + fixed payload fields
+    static constexpr size_t MAX_PARTS       = 6;
+
+    // Frame over an existing buffer (borrowed, not copied)
+    static Frame wrap(const std::vector<uint8_t>& bytes);
+
+    // Inline writers; throw runtime_error past INLINE_CAPACITY
+    void putUint8(uint8_t v);
+    void putUint16LE(uint16_t v);
+    void putUint32LE(uint32_t v);
+    void putBytes(const uint8_t* data, size_t size);
+    // Claims `size` inline bytes for the caller to fill (e.g. a wire:: record)
+    uint8_t* appendInline(size_t size);
+
+    // Data referenced in place, not copied
+    void putBorrowed(const uint8_t* data, size_t size);
+
+    size_t size() const { return total; }
+
+    // Fills `out` with the pieces in order; returns how many were written
+    size_t gather(IoSlice (&out)[MAX_PARTS]) const;
+
+    // One contiguous copy of the whole message
+    std::vector<uint8_t> flatten() const;
+
+private:
+    struct Part {
+        const uint8_t* borrowed = nullptr;   // null = inline piece
+        size_t         offset   = 0;         // into inlineBytes
+        size_t         size     = 0;
+    };
+
+    Part& newPart();
+
+    std::array<uint8_t, INLINE_CAPACITY> inlineBytes{};
+    size_t                               inlineUsed = 0;
+    std::array<Part, MAX_PARTS>          parts{};
+    size_t                               partCount = 0;
+    size_t                               total     = 0;
+};
@@ -0,0 +1,107 @@
+#include "IdentityStore.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+
+static const uint8_t MAGIC[4]       = { 'M', 'U', 'I', 'D' };
+static const uint8_t FORMAT_VERSION = 1;
+
+// helper: bytes → hex
+static std::string toHex(const std::vector<uint8_t>& b) {
+    std::ostringstream oss;
+    for (auto x : b) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << int(x);
+    }
+    return oss.str();
+}
+// helper: hex → bytes (false on odd length / non-hex)
+static bool hexToBytes(const std::string& s, std::vector<uint8_t>& out) {
+    if (s.size() % 2) return false;
+    out.clear();
+    out.reserve(s.size() / 2);
+    for (size_t i = 0; i < s.size(); i += 2) {
+        char* end = nullptr;
+        std::string byte = s.substr(i, 2);
+        unsigned long v = std::strtoul(byte.c_str(), &end, 16);
+        if (end != byte.c_str() + 2) return false;
+        out.push_back(static_cast<uint8_t>(v));
+    }
+    return true;
+}
+
+bool IdentityStore::loadBinary(const std::string& path, Identity& out) {
+    // Single read of the whole (small) file, then parse from memory
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::vector<uint8_t> buf{ std::istreambuf_iterator<char>(f), {} };
+
+    size_t pos = 0;
+    auto need = [&](size_t n) { return buf.size() - pos >= n; };
+
+    if (!need(6) || !std::equal(MAGIC, MAGIC + 4, buf.begin()) || buf[4] != FORMAT_VERSION)
+        return false;
+    size_t nameLen = buf[5];
+    pos = 6;
+
+    if (!need(nameLen + 16 + 4)) return false;
+    out.username.assign(buf.begin() + pos, buf.begin() + pos + nameLen);
+    pos += nameLen;
+    out.clientId.assign(buf.begin() + pos, buf.begin() + pos + 16);
+    pos += 16;
+
+    uint32_t keyLen = buf[pos] | (buf[pos+1] << 8) | (buf[pos+2] << 16)
+                      | (static_cast<uint32_t>(buf[pos+3]) << 24);
+    pos += 4;
+    if (!need(keyLen) || buf.size() - pos != keyLen) return false;
+    out.privateKeyDER.assign(buf.begin() + pos, buf.end());
+    out.privateKeyPEM.clear();
+    return true;
+}
+
+bool IdentityStore::importText(const std::string& path, Identity& out) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::string name, hexid, pem;
+    std::getline(f, name);
+    std::getline(f, hexid);
+    std::getline(f, pem);
+
+    std::vector<uint8_t> id;
+    if (!hexToBytes(hexid, id) || id.size() != 16 || pem.empty()) return false;
+
+    out.username      = name;
+    out.clientId      = id;
+    out.privateKeyPEM = pem;
+    out.privateKeyDER.clear();
+    return true;
+}
+
+bool IdentityStore::saveBinary(const std::string& path, const Identity& id) {
+    if (id.username.size() > 255 || id.clientId.size() != 16) return false;
+
+    std::vector<uint8_t> buf(MAGIC, MAGIC + 4);
+    buf.push_back(FORMAT_VERSION);
+    buf.push_back(static_cast<uint8_t>(id.username.size()));
+    buf.insert(buf.end(), id.username.begin(), id.username.end());
+    buf.insert(buf.end(), id.clientId.begin(), id.clientId.end());
+    uint32_t keyLen = static_cast<uint32_t>(id.privateKeyDER.size());
+    for (int shift = 0; shift < 32; shift += 8) {
+        buf.push_back(static_cast<uint8_t>(keyLen >> shift));
+    }
+    buf.insert(buf.end(), id.privateKeyDER.begin(), id.privateKeyDER.end());
+
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+    return f.good();
+}
+
+bool IdentityStore::saveText(const std::string& path, const Identity& id) {
+    std::ofstream f(path);
+    f << id.username << "\n"
+      << toHex(id.clientId) << "\n"
+      << id.privateKeyPEM  << "\n";
+    return f.good();
+}
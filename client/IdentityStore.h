@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Who we are between runs: username, server-assigned ID and RSA private key
+struct Identity {
+    std::string          username;
+    std::vector<uint8_t> clientId;        // 16 bytes
+    std::vector<uint8_t> privateKeyDER;   // PKCS#1 RSAPrivateKey (me.bin)
+    std::string          privateKeyPEM;   // base64 of the same DER (me.info)
+};
+
+// Persists the identity in two formats:
+//   me.bin  – compact binary, read in one go at startup:
+//             "MUID" | ver(1) | nameLen(1) | name | id(16) | keyLen(4 LE) | key DER
+//   me.info – the original text format (name / hex ID / base64 key, one per
+//             line), kept for compatibility and imported when me.bin is missing
+class IdentityStore {
+public:
+    static constexpr const char* BINARY_FILE = "me.bin";
+    static constexpr const char* TEXT_FILE   = "me.info";
+
+    // Both return false if the file is missing or malformed
+    static bool loadBinary(const std::string& path, Identity& out);
+    static bool importText(const std::string& path, Identity& out);
+
+    static bool saveBinary(const std::string& path, const Identity& id);
+    static bool saveText(const std::string& path, const Identity& id);
+};
@@ -0,0 +1,435 @@
+#include "KeyStore.h"
+#include "CryptoManager.h"
+#include "ProtocolSchema.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/* ─── On-disk layout ───────────────────────────── */
+
+const uint8_t MAGIC[4]       = { 'M', 'U', 'K', 'S' };
+const uint8_t FORMAT_VERSION = 1;
+
+// ---- keys.idx header: [4 magic][1 version][3 reserved][4 slotCount][4 used][8 liveBytes][16 keyCheck] ----
+// liveBytes: size of the records the index points at; the rest of keys.dat
+// is superseded values, reclaimed by compaction
+struct IndexHeader : wire::Record<wire::Bytes<4>, wire::U8, wire::Bytes<3>,
+                                  wire::U32, wire::U32, wire::U64, wire::Bytes<16>> {
+    enum { MAGIC, VERSION, RESERVED, SLOT_COUNT, USED, LIVE_BYTES, KEY_CHECK };
+};
+constexpr size_t HEADER_SIZE = 64;   // header, padded; slots start here
+static_assert(IndexHeader::SIZE <= HEADER_SIZE);
+
+// ---- keys.idx slot: [16 id][1 kind][3 reserved][4 length][8 offset] – kind 0 = empty ----
+struct IndexSlot : wire::Record<wire::Id, wire::U8, wire::Bytes<3>, wire::U32, wire::U64> {
+    enum { ID, KIND, RESERVED, LENGTH, OFFSET };
+};
+static_assert(IndexSlot::SIZE == 32);
+
+const uint8_t ZERO[16] = {};
+
+constexpr uint32_t INITIAL_SLOTS  = 256;            // power of two
+constexpr uint32_t MAX_LOAD_PCT   = 70;             // grow beyond this
+constexpr uint64_t COMPACT_SLACK  = 1024 * 1024;    // dead bytes tolerated before compacting
+constexpr size_t   NONCE_SIZE     = CryptoManager::GCM_NONCE_SIZE;
+constexpr size_t   MIN_RECORD     = NONCE_SIZE + CryptoManager::GCM_TAG_SIZE;
+constexpr size_t   MAX_RECORD     = 2 * 1024 * 1024; // a 65535-member group is ~1 MiB
+
+size_t indexFileSize(uint32_t slots) { return HEADER_SIZE + size_t(slots) * IndexSlot::SIZE; }
+
+// Fixed across platforms and runs (unlike std::hash), since it places slots on disk
+uint64_t slotHash(const ClientId& id, uint8_t kind) {
+    uint64_t lo = wire::U64::read(id.data());
+    uint64_t hi = wire::U64::read(id.data() + 8);
+    uint64_t h  = lo ^ (hi * 0x9E3779B97F4A7C15ULL) ^ kind;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// Associated data of a record: the slot it belongs to
+std::array<uint8_t, 17> recordAAD(const ClientId& id, uint8_t kind) {
+    std::array<uint8_t, 17> aad;
+    std::memcpy(aad.data(), id.data(), 16);
+    aad[16] = kind;
+    return aad;
+}
+
+/* ─── Table over a mapped index ────────────────── */
+
+struct SlotTable {
+    uint8_t* base;    // start of the mapped file
+    uint32_t slots;
+
+    uint8_t* slot(size_t i) const { return base + HEADER_SIZE + i * IndexSlot::SIZE; }
+
+    // The slot holding (id, kind), or the empty one where it would go.
+    // Null if every slot holds another key: the load limit rules that out
+    // unless the index is damaged (its `used` count too low).
+    uint8_t* probe(const ClientId& id, uint8_t kind) const {
+        size_t mask = slots - 1;
+        size_t i    = slotHash(id, kind) & mask;
+        for (size_t n = 0; n < slots; ++n, i = (i + 1) & mask) {
+            uint8_t* s = slot(i);
+            uint8_t k = IndexSlot::get<IndexSlot::KIND>(s);
+            if (k == 0) return s;
+            if (k == kind && std::memcmp(s, id.data(), 16) == 0) return s;
+        }
+        return nullptr;
+    }
+
+    uint32_t used() const      { return IndexHeader::get<IndexHeader::USED>(base); }
+    uint64_t liveBytes() const { return IndexHeader::get<IndexHeader::LIVE_BYTES>(base); }
+    void setUsed(uint32_t n)      { IndexHeader::set<IndexHeader::USED>(base, n); }
+    void setLiveBytes(uint64_t n) { IndexHeader::set<IndexHeader::LIVE_BYTES>(base, n); }
+};
+
+/* ─── Memory-mapped file ───────────────────────── */
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    // Maps `path` read-write, creating it or zero-extending it to at least `minSize`
+    bool open(const std::string& path, size_t minSize) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                           nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER current;
+        if (!GetFileSizeEx(file, &current)) { close(); return false; }
+        size_t size = std::max(static_cast<size_t>(current.QuadPart), minSize);
+        // A mapping larger than the file extends it
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                     static_cast<DWORD>(uint64_t(size) >> 32),
+                                     static_cast<DWORD>(size), nullptr);
+        if (!mapping) { close(); return false; }
+        void* p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (!p) { close(); return false; }
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) { close(); return false; }
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size < minSize) {
+            if (ftruncate(fd, static_cast<off_t>(minSize)) != 0) { close(); return false; }
+            size = minSize;
+        }
+        if (size == 0) { close(); return false; }
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) { close(); return false; }
+#endif
+        base   = static_cast<uint8_t*>(p);
+        length = size;
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file    = INVALID_HANDLE_VALUE;
+#else
+        if (base) munmap(base, length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        base   = nullptr;
+        length = 0;
+    }
+
+    uint8_t* data() const { return base; }
+    size_t   size() const { return length; }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    uint8_t* base   = nullptr;
+    size_t   length = 0;
+#ifdef _WIN32
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// Creates `path` as an empty index of `slots` slots, mapped in `file`
+bool createIndex(MappedFile& file, const std::string& path, uint32_t slots,
+                 const uint8_t* keyCheck) {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    if (!file.open(path, indexFileSize(slots))) return false;
+    IndexHeader::write(file.data(), MAGIC, FORMAT_VERSION, ZERO, slots, 0, 0, keyCheck);
+    return true;
+}
+
+// Opens `path` for reading and appending, creating it if needed
+bool openData(std::fstream& f, const std::string& path, uint64_t& size) {
+    f.close();
+    f.clear();
+    { std::ofstream touch(path, std::ios::binary | std::ios::app); if (!touch) return false; }
+    f.open(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!f) return false;
+    f.seekg(0, std::ios::end);
+    size = static_cast<uint64_t>(f.tellg());
+    return true;
+}
+
+}  // namespace
+
+/* ─── KeyStore ─────────────────────────────────── */
+
+struct KeyStore::Impl {
+    const CryptoManager& crypto;
+    std::vector<uint8_t> key;        // AES-256 sealing key
+    std::vector<uint8_t> keyCheck;   // 16 bytes identifying `key` in the header
+    std::string          indexPath, dataPath;
+
+    MappedFile   indexFile;
+    SlotTable    table{ nullptr, 0 };
+    std::fstream data;
+    uint64_t     dataSize = 0;
+
+    explicit Impl(const CryptoManager& c) : crypto(c) {}
+
+    bool readRecord(const uint8_t* slot, std::vector<uint8_t>& raw);
+    void open();
+    void reset();
+    void rebuild(uint32_t slots);   // grows and/or compacts
+};
+
+// Raw record bytes for an occupied slot; false if they aren't in keys.dat
+bool KeyStore::Impl::readRecord(const uint8_t* slot, std::vector<uint8_t>& raw) {
+    uint64_t len = IndexSlot::get<IndexSlot::LENGTH>(slot);
+    uint64_t off = IndexSlot::get<IndexSlot::OFFSET>(slot);
+    if (len < MIN_RECORD || len > MAX_RECORD || off > dataSize || dataSize - off < len) {
+        return false;
+    }
+    raw.resize(static_cast<size_t>(len));
+    data.clear();
+    data.seekg(static_cast<std::streamoff>(off));
+    data.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(len));
+    return static_cast<bool>(data);
+}
+
+void KeyStore::Impl::open() {
+    if (!openData(data, dataPath, dataSize)) {
+        throw std::runtime_error("KeyStore: cannot open " + dataPath);
+    }
+
+    std::error_code ec;
+    bool exists = std::filesystem::exists(indexPath, ec);
+    if (exists && indexFile.open(indexPath, 0) && indexFile.size() >= HEADER_SIZE) {
+        const uint8_t* h = indexFile.data();
+        uint32_t slots   = IndexHeader::get<IndexHeader::SLOT_COUNT>(h);
+        bool valid = std::memcmp(IndexHeader::get<IndexHeader::MAGIC>(h), MAGIC, 4) == 0
+                  && IndexHeader::get<IndexHeader::VERSION>(h) == FORMAT_VERSION
+                  && slots >= INITIAL_SLOTS && (slots & (slots - 1)) == 0
+                  && indexFile.size() == indexFileSize(slots)
+                  && IndexHeader::get<IndexHeader::USED>(h) < slots
+                  && std::memcmp(IndexHeader::get<IndexHeader::KEY_CHECK>(h),
+                                 keyCheck.data(), 16) == 0;
+        if (valid) {
+            table = SlotTable{ indexFile.data(), slots };
+            return;
+        }
+    }
+    // Missing, damaged, or another identity's – its records are unreadable anyway
+    reset();
+}
+
+void KeyStore::Impl::reset() {
+    indexFile.close();
+    data.close();
+    std::error_code ec;
+    std::filesystem::remove(dataPath, ec);
+    if (!openData(data, dataPath, dataSize)) {
+        throw std::runtime_error("KeyStore: cannot create " + dataPath);
+    }
+    if (!createIndex(indexFile, indexPath, INITIAL_SLOTS, keyCheck.data())) {
+        throw std::runtime_error("KeyStore: cannot create " + indexPath);
+    }
+    table = SlotTable{ indexFile.data(), INITIAL_SLOTS };
+}
+
+// Copies the live records into fresh files next to the old ones, then swaps
+// them in; a crash before the swap leaves the old store intact
+void KeyStore::Impl::rebuild(uint32_t slots) {
+    std::string indexTmp = indexPath + ".tmp";
+    std::string dataTmp  = dataPath + ".tmp";
+
+    MappedFile newIndex;
+    if (!createIndex(newIndex, indexTmp, slots, keyCheck.data())) {
+        throw std::runtime_error("KeyStore: cannot create " + indexTmp);
+    }
+    SlotTable newTable{ newIndex.data(), slots };
+    std::ofstream newData(dataTmp, std::ios::binary | std::ios::trunc);
+    if (!newData) {
+        throw std::runtime_error("KeyStore: cannot create " + dataTmp);
+    }
+
+    uint64_t written = 0;
+    uint32_t used    = 0;
+    std::vector<uint8_t> raw;
+    for (size_t i = 0; i < table.slots; ++i) {
+        const uint8_t* s = table.slot(i);
+        uint8_t kind = IndexSlot::get<IndexSlot::KIND>(s);
+        if (kind == 0 || !readRecord(s, raw)) continue;   // unreadable records are dropped
+
+        // Still valid as is: the AAD binds a record to (id, kind), not to its offset
+        ClientId id  = IndexSlot::get<IndexSlot::ID>(s);
+        uint8_t* dst = newTable.probe(id, kind);
+        if (!dst) {
+            throw std::runtime_error("KeyStore: index full during rebuild");
+        }
+        newData.write(reinterpret_cast<const char*>(raw.data()),
+                      static_cast<std::streamsize>(raw.size()));
+        IndexSlot::write(dst, id, kind, ZERO, static_cast<uint32_t>(raw.size()), written);
+        written += raw.size();
+        ++used;
+    }
+    newData.close();
+    if (!newData) {
+        throw std::runtime_error("KeyStore: cannot write " + dataTmp);
+    }
+    newTable.setUsed(used);
+    newTable.setLiveBytes(written);
+    newIndex.close();
+
+    indexFile.close();
+    data.close();
+    // std::filesystem::rename replaces an existing target on every platform
+    std::error_code ec;
+    std::filesystem::rename(dataTmp, dataPath, ec);
+    if (!ec) std::filesystem::rename(indexTmp, indexPath, ec);
+    if (ec) {
+        throw std::runtime_error("KeyStore: cannot replace store: " + ec.message());
+    }
+    open();
+}
+
+KeyStore::KeyStore(const CryptoManager& crypto, const std::vector<uint8_t>& identityKeyDER,
+                   const std::string& indexPath, const std::string& dataPath)
+    : impl(std::make_unique<Impl>(crypto))
+{
+    // Domain-separated, so the derived key is never the hash of the bare key
+    static const char KEY_LABEL[]   = "MessageU keystore key v1";
+    static const char CHECK_LABEL[] = "MessageU keystore check v1";
+
+    std::vector<uint8_t> material(KEY_LABEL, KEY_LABEL + sizeof(KEY_LABEL));
+    material.insert(material.end(), identityKeyDER.begin(), identityKeyDER.end());
+    impl->key = CryptoManager::sha256(material.data(), material.size());
+
+    material.assign(CHECK_LABEL, CHECK_LABEL + sizeof(CHECK_LABEL));
+    material.insert(material.end(), impl->key.begin(), impl->key.end());
+    impl->keyCheck = CryptoManager::sha256(material.data(), material.size());
+    impl->keyCheck.resize(16);
+
+    impl->indexPath = indexPath;
+    impl->dataPath  = dataPath;
+    impl->open();
+}
+
+KeyStore::~KeyStore() = default;
+
+bool KeyStore::get(const ClientId& id, Kind kind, std::vector<uint8_t>& out) {
+    uint8_t k = static_cast<uint8_t>(kind);
+    const uint8_t* s = impl->table.probe(id, k);
+    std::vector<uint8_t> raw;
+    if (!s || IndexSlot::get<IndexSlot::KIND>(s) == 0 || !impl->readRecord(s, raw)) return false;
+
+    auto aad = recordAAD(id, k);
+    try {
+        out = impl->crypto.aesGCMDecrypt(impl->key, raw.data(), aad.data(), aad.size(),
+                                         raw.data() + NONCE_SIZE, raw.size() - NONCE_SIZE);
+    } catch (const std::exception&) {
+        return false;   // tampered, or written under another key
+    }
+    return true;
+}
+
+void KeyStore::put(const ClientId& id, Kind kind, const std::vector<uint8_t>& value) {
+    if (value.size() > MAX_RECORD - MIN_RECORD) {
+        throw std::runtime_error("KeyStore: value too large");
+    }
+    uint8_t k = static_cast<uint8_t>(kind);
+
+    // Grow first, so the probe below lands in the final table. No slot at
+    // all means `used` undercounts; the rebuild recounts it.
+    const uint8_t* found = impl->table.probe(id, k);
+    if (!found || (IndexSlot::get<IndexSlot::KIND>(found) == 0
+                   && (uint64_t(impl->table.used()) + 1) * 100
+                      > uint64_t(impl->table.slots) * MAX_LOAD_PCT)) {
+        impl->rebuild(impl->table.slots * 2);
+    }
+
+    // Append the sealed record, then point the index at it: a crash in
+    // between leaves the previous value in effect
+    std::vector<uint8_t> record = impl->crypto.randomBytes(NONCE_SIZE);
+    auto aad    = recordAAD(id, k);
+    auto sealed = impl->crypto.aesGCMEncrypt(impl->key, record.data(), aad.data(), aad.size(),
+                                             value.data(), value.size());
+    record.insert(record.end(), sealed.begin(), sealed.end());
+
+    uint64_t offset = impl->dataSize;
+    impl->data.clear();
+    impl->data.seekp(static_cast<std::streamoff>(offset));
+    impl->data.write(reinterpret_cast<const char*>(record.data()),
+                     static_cast<std::streamsize>(record.size()));
+    impl->data.flush();
+    if (!impl->data) {
+        throw std::runtime_error("KeyStore: cannot write " + impl->dataPath);
+    }
+    impl->dataSize += record.size();
+
+    uint8_t* s = impl->table.probe(id, k);
+    if (!s) {
+        throw std::runtime_error("KeyStore: index full");
+    }
+    uint64_t live = impl->table.liveBytes() + record.size();
+    if (IndexSlot::get<IndexSlot::KIND>(s) == 0) {
+        impl->table.setUsed(impl->table.used() + 1);
+    } else {
+        live -= IndexSlot::get<IndexSlot::LENGTH>(s);
+    }
+    IndexSlot::write(s, id, k, ZERO, static_cast<uint32_t>(record.size()), offset);
+    impl->table.setLiveBytes(live);
+
+    // Re-keying the same peers only ever appends; reclaim once most of the log is dead
+    if (impl->dataSize > 2 * live + COMPACT_SLACK) {
+        impl->rebuild(impl->table.slots);
+    }
+}
+
+size_t KeyStore::size() const {
+    return impl->table.used();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include "ClientId.h"
+
+class CryptoManager;
+
+// Keys that outlive a run – peer / group symmetric keys and peer RSA public
+// keys – so a restart doesn't cost another 151/152 exchange or 602 lookup;
+// also the name and members of each group we belong to.
+//   keys.idx – open-addressing table, memory-mapped:
+//              (id, kind) → (offset, length) of the record in keys.dat
+//   keys.dat – append-only log of sealed records: nonce(12) | ciphertext | tag(16)
+// Opening maps the index and reads nothing else, so startup doesn't depend
+// on the number of peers; a lookup probes the table and reads one record.
+// Records are AES-256-GCM sealed under a key derived from our RSA private
+// key, with (id, kind) as associated data. The store is only a cache: a
+// record that is missing, damaged or sealed for another identity reads as
+// absent, and the key is simply exchanged again.
+class KeyStore {
+public:
+    enum class Kind : uint8_t {
+        SymmetricKey = 1,
+        PublicKey    = 2,
+        Group        = 3,   // group ID → name and member list
+        GroupList    = 4,   // under the zero ID: every group ID, 16 bytes each
+    };
+
+    static constexpr const char* INDEX_FILE = "keys.idx";
+    static constexpr const char* DATA_FILE  = "keys.dat";
+
+    // Opens the store, or starts an empty one if there is none or it was
+    // sealed with another identity; throws runtime_error if the files can't
+    // be created
+    KeyStore(const CryptoManager& crypto, const std::vector<uint8_t>& identityKeyDER,
+             const std::string& indexPath = INDEX_FILE,
+             const std::string& dataPath  = DATA_FILE);
+    ~KeyStore();
+
+    // False if there is no readable record for (id, kind)
+    bool get(const ClientId& id, Kind kind, std::vector<uint8_t>& out);
+    // Replaces any earlier value; throws runtime_error on I/O failure
+    void put(const ClientId& id, Kind kind, const std::vector<uint8_t>& value);
+
+    size_t size() const;   // records in the index
+
+    KeyStore(const KeyStore&)            = delete;
+    KeyStore& operator=(const KeyStore&) = delete;
+
+private:
+    struct Impl;   // mapped index, data file, sealing key – in KeyStore.cpp
+    std::unique_ptr<Impl> impl;
+};
@@ -0,0 +1,361 @@
+#include "Metrics.h"
+
+#if CLIENT_ENABLE_METRICS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+/* ─── Histogram ────────────────────────────────── */
+
+// Log-linear buckets over nanoseconds: values below 64 get a bucket each,
+// above that every power of two is split into 32 equal buckets. Values
+// past 2^40 ns (~18 minutes) land in the last bucket.
+class Histogram {
+public:
+    static constexpr unsigned SUB_BITS = 6;
+    static constexpr uint64_t SUB      = uint64_t(1) << SUB_BITS;
+    static constexpr uint64_t HALF     = SUB / 2;
+    static constexpr unsigned MAX_MSB  = 40;
+    static constexpr size_t   BUCKETS  = SUB + (MAX_MSB - SUB_BITS + 1) * HALF;
+
+    void record(uint64_t ns) {
+        buckets[indexOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t seen = max.load(std::memory_order_relaxed);
+        while (ns > seen && !max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count()  const { return total.load(std::memory_order_relaxed); }
+    uint64_t sumNs()  const { return sum.load(std::memory_order_relaxed); }
+    uint64_t maxNs()  const { return max.load(std::memory_order_relaxed); }
+
+    // Midpoint of the bucket holding the p-th value, never above the maximum
+    uint64_t percentileNs(double p) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * n + 0.999999);
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(midpointOf(i), maxNs());
+        }
+        return maxNs();
+    }
+
+    void reset() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static unsigned msbOf(uint64_t v) {
+#if defined(__GNUC__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+        unsigned m = 0;
+        while (v >>= 1) ++m;
+        return m;
+#endif
+    }
+
+    static size_t indexOf(uint64_t v) {
+        if (v < SUB) return static_cast<size_t>(v);
+        unsigned msb = msbOf(v);
+        if (msb > MAX_MSB) return BUCKETS - 1;
+        unsigned shift = msb - (SUB_BITS - 1);
+        return static_cast<size_t>(SUB + (msb - SUB_BITS) * HALF + ((v >> shift) - HALF));
+    }
+
+    static uint64_t midpointOf(size_t index) {
+        if (index < SUB) return index;
+        size_t   k     = index - SUB;
+        unsigned msb   = SUB_BITS + static_cast<unsigned>(k / HALF);
+        unsigned shift = msb - (SUB_BITS - 1);
+        uint64_t low   = (HALF + k % HALF) << shift;
+        return low + ((uint64_t(1) << shift) >> 1);
+    }
+
+    std::atomic<uint64_t> buckets[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+const char* const PHASE_NAMES[Metrics::PHASE_COUNT] = { "serialize", "network", "parse", "crypto" };
+
+const char* const PRIMITIVE_NAMES[Metrics::PRIMITIVE_COUNT] = {
+    "aes_encrypt", "aes_decrypt", "aes_encrypt_stream", "aes_decrypt_stream",
+    "rsa_encrypt", "rsa_decrypt", "rsa_keygen", "deflate", "inflate"
+};
+
+thread_local uint16_t tlsResponded = 0;
+thread_local uint16_t tlsScope     = 0;
+
+double toUs(uint64_t ns) { return ns / 1000.0; }
+
+void writeLatencyJson(std::ostream& out, const Histogram& h) {
+    uint64_t n = h.count();
+    out << "{\"count\": " << n
+        << ", \"mean_us\": " << (n ? toUs(h.sumNs()) / n : 0.0)
+        << ", \"p50_us\": "  << toUs(h.percentileNs(0.50))
+        << ", \"p99_us\": "  << toUs(h.percentileNs(0.99))
+        << ", \"p999_us\": " << toUs(h.percentileNs(0.999))
+        << ", \"max_us\": "  << toUs(h.maxNs()) << "}";
+}
+
+void writeLatencyRow(std::ostream& out, const Histogram& h) {
+    out << std::setw(10) << h.count()
+        << std::setw(11) << toUs(h.percentileNs(0.50))
+        << std::setw(11) << toUs(h.percentileNs(0.99))
+        << std::setw(11) << toUs(h.percentileNs(0.999))
+        << std::setw(11) << toUs(h.maxNs());
+}
+
+} // namespace
+
+struct Metrics::State {
+    struct Request {
+        Histogram             phases[PHASE_COUNT];
+        std::atomic<uint64_t> bytesOut{0};
+        std::atomic<uint64_t> bytesIn{0};
+    };
+    struct Crypto {
+        Histogram             latency;
+        std::atomic<uint64_t> bytesIn{0};
+        std::atomic<uint64_t> bytesOut{0};
+    };
+
+    Request requests[CODE_COUNT];
+    Crypto  crypto[PRIMITIVE_COUNT];
+    std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+
+    // Periodic dump
+    mutable std::mutex      dumpMutex;
+    std::condition_variable dumpWake;
+    std::thread             dumpThread;
+    bool                    dumpStop = false;
+};
+
+/* ─── Recording ────────────────────────────────── */
+
+Metrics::Metrics() : state(new State) {}
+
+Metrics::~Metrics() {
+    stopDump();
+    delete state;
+}
+
+Metrics& Metrics::shared() {
+    static Metrics metrics;
+    return metrics;
+}
+
+uint64_t Metrics::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Metrics::recordPhase(uint16_t code, Phase phase, uint64_t ns) {
+    size_t slot = static_cast<size_t>(code - FIRST_CODE);
+    if (code < FIRST_CODE || slot >= CODE_COUNT) return;
+    state->requests[slot].phases[static_cast<size_t>(phase)].record(ns);
+}
+
+void Metrics::recordBytes(uint16_t code, uint64_t bytesOut, uint64_t bytesIn) {
+    size_t slot = static_cast<size_t>(code - FIRST_CODE);
+    if (code < FIRST_CODE || slot >= CODE_COUNT) return;
+    state->requests[slot].bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+    state->requests[slot].bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+}
+
+void Metrics::recordCrypto(Primitive primitive, uint64_t ns, uint64_t bytesIn, uint64_t bytesOut) {
+    auto& c = state->crypto[static_cast<size_t>(primitive)];
+    c.latency.record(ns);
+    c.bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+    c.bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+}
+
+uint16_t Metrics::respondedRequest()              { return tlsResponded; }
+void     Metrics::setRespondedRequest(uint16_t code) { tlsResponded = code; }
+uint16_t Metrics::scopedRequest()                 { return tlsScope; }
+
+RequestScope::RequestScope(uint16_t code) : previous(tlsScope) {
+    tlsScope = code;
+}
+
+RequestScope::~RequestScope() {
+    tlsScope = previous;
+}
+
+CryptoTimer::~CryptoTimer() {
+    uint64_t elapsed = Metrics::nowNs() - start;
+    elapsed = elapsed > excluded ? elapsed - excluded : 0;
+    Metrics& m = Metrics::shared();
+    m.recordCrypto(primitive, elapsed, bytesIn, bytesOut);
+    if (tlsScope) m.recordPhase(tlsScope, Metrics::Phase::Crypto, elapsed);
+}
+
+void Metrics::reset() {
+    for (auto& r : state->requests) {
+        for (auto& h : r.phases) h.reset();
+        r.bytesOut.store(0, std::memory_order_relaxed);
+        r.bytesIn.store(0, std::memory_order_relaxed);
+    }
+    for (auto& c : state->crypto) {
+        c.latency.reset();
+        c.bytesIn.store(0, std::memory_order_relaxed);
+        c.bytesOut.store(0, std::memory_order_relaxed);
+    }
+    state->since = std::chrono::steady_clock::now();
+}
+
+/* ─── Reports ──────────────────────────────────── */
+
+void Metrics::print(std::ostream& out) const {
+    auto flags = out.flags();
+    auto prec  = out.precision();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - state->since).count();
+
+    out << std::fixed << std::setprecision(1)
+        << "Requests (latency in us, over " << secs << " s):\n"
+        << std::setw(6) << "code" << std::setw(11) << "phase" << std::setw(10) << "count"
+        << std::setw(11) << "p50" << std::setw(11) << "p99" << std::setw(11) << "p999"
+        << std::setw(11) << "max" << std::setw(12) << "bytes out" << std::setw(12) << "bytes in" << "\n";
+    for (size_t slot = 0; slot < CODE_COUNT; ++slot) {
+        const auto& r = state->requests[slot];
+        bool first = true;
+        for (size_t p = 0; p < PHASE_COUNT; ++p) {
+            if (r.phases[p].count() == 0) continue;
+            out << std::setw(6);
+            if (first) out << FIRST_CODE + slot; else out << "";
+            out << std::setw(11) << PHASE_NAMES[p];
+            writeLatencyRow(out, r.phases[p]);
+            if (first) {
+                out << std::setw(12) << r.bytesOut.load(std::memory_order_relaxed)
+                    << std::setw(12) << r.bytesIn.load(std::memory_order_relaxed);
+            }
+            out << "\n";
+            first = false;
+        }
+    }
+
+    out << "\nCrypto (latency in us):\n"
+        << std::setw(19) << "primitive" << std::setw(10) << "count"
+        << std::setw(11) << "p50" << std::setw(11) << "p99" << std::setw(11) << "p999"
+        << std::setw(11) << "max" << std::setw(12) << "bytes in" << std::setw(12) << "bytes out"
+        << std::setw(10) << "MB/s" << "\n";
+    for (size_t i = 0; i < PRIMITIVE_COUNT; ++i) {
+        const auto& c = state->crypto[i];
+        if (c.latency.count() == 0) continue;
+        uint64_t in = c.bytesIn.load(std::memory_order_relaxed);
+        uint64_t ns = c.latency.sumNs();
+        out << std::setw(19) << PRIMITIVE_NAMES[i];
+        writeLatencyRow(out, c.latency);
+        out << std::setw(12) << in << std::setw(12) << c.bytesOut.load(std::memory_order_relaxed)
+            << std::setw(10) << (ns ? (in / (1024.0 * 1024.0)) / (ns / 1e9) : 0.0) << "\n";
+    }
+    out.flags(flags);
+    out.precision(prec);
+}
+
+std::string Metrics::toJson() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3)
+        << "{\"elapsed_s\": "
+        << std::chrono::duration<double>(std::chrono::steady_clock::now() - state->since).count()
+        << ",\n \"requests\": [";
+    bool firstCode = true;
+    for (size_t slot = 0; slot < CODE_COUNT; ++slot) {
+        const auto& r = state->requests[slot];
+        bool any = false;
+        for (const auto& h : r.phases) any = any || h.count() != 0;
+        if (!any) continue;
+
+        out << (firstCode ? "\n  " : ",\n  ")
+            << "{\"code\": " << FIRST_CODE + slot
+            << ", \"bytes_out\": " << r.bytesOut.load(std::memory_order_relaxed)
+            << ", \"bytes_in\": "  << r.bytesIn.load(std::memory_order_relaxed);
+        for (size_t p = 0; p < PHASE_COUNT; ++p) {
+            out << ",\n   \"" << PHASE_NAMES[p] << "\": ";
+            writeLatencyJson(out, r.phases[p]);
+        }
+        out << "}";
+        firstCode = false;
+    }
+    out << "],\n \"crypto\": [";
+    bool firstPrim = true;
+    for (size_t i = 0; i < PRIMITIVE_COUNT; ++i) {
+        const auto& c = state->crypto[i];
+        if (c.latency.count() == 0) continue;
+        out << (firstPrim ? "\n  " : ",\n  ")
+            << "{\"primitive\": \"" << PRIMITIVE_NAMES[i] << "\""
+            << ", \"bytes_in\": "  << c.bytesIn.load(std::memory_order_relaxed)
+            << ", \"bytes_out\": " << c.bytesOut.load(std::memory_order_relaxed)
+            << ",\n   \"latency\": ";
+        writeLatencyJson(out, c.latency);
+        out << "}";
+        firstPrim = false;
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+/* ─── Periodic dump ────────────────────────────── */
+
+bool Metrics::startDump(const std::string& path, unsigned intervalSec) {
+    std::lock_guard<std::mutex> lock(state->dumpMutex);
+    if (state->dumpThread.joinable()) return false;
+    state->dumpStop = false;
+
+    auto interval = std::chrono::seconds(intervalSec ? intervalSec : 1);
+    state->dumpThread = std::thread([this, path, interval] {
+        std::unique_lock<std::mutex> lock(state->dumpMutex);
+        while (!state->dumpWake.wait_for(lock, interval, [this] { return state->dumpStop; })) {
+            lock.unlock();
+            // Written aside and renamed, so readers never see a partial file
+            std::string tmp = path + ".tmp";
+            {
+                std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+                f << toJson();
+            }
+            std::remove(path.c_str());
+            std::rename(tmp.c_str(), path.c_str());
+            lock.lock();
+        }
+    });
+    return true;
+}
+
+void Metrics::stopDump() {
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(state->dumpMutex);
+        if (!state->dumpThread.joinable()) return;
+        state->dumpStop = true;
+        t = std::move(state->dumpThread);
+    }
+    state->dumpWake.notify_all();
+    t.join();
+}
+
+bool Metrics::dumping() const {
+    std::lock_guard<std::mutex> lock(state->dumpMutex);
+    return state->dumpThread.joinable();
+}
+
+#endif // CLIENT_ENABLE_METRICS
@@ -0,0 +1,172 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#ifndef CLIENT_ENABLE_METRICS
+#define CLIENT_ENABLE_METRICS 0
+#endif
+
+// Where client time goes: per request code (600–609) a latency histogram
+// for each phase – building the frame, waiting on the network, parsing the
+// response and the crypto done on its behalf – plus bytes sent / received;
+// per crypto primitive calls, bytes in / out and latency.
+//
+//   PhaseTimer t(603, Metrics::Phase::Serialize);   // recorded when t leaves scope
+//   CryptoTimer c(Metrics::Primitive::AesEncrypt, size);
+//   RequestScope s(603);   // crypto on this thread (and its parallelFor) counts for 603
+//
+// Histograms are log-linear (HDR-style): 32 buckets per power of two, so a
+// percentile is within ~3% of the true value; recording is a few relaxed
+// atomic adds and safe from any thread. Built with CLIENT_ENABLE_METRICS=0
+// every type here is an empty inline stub and the timers compile away.
+class Metrics {
+public:
+    enum class Phase : uint8_t { Serialize, Network, Parse, Crypto };
+    static constexpr size_t PHASE_COUNT = 4;
+
+    enum class Primitive : uint8_t {
+        AesEncrypt, AesDecrypt, AesEncryptStream, AesDecryptStream,
+        RsaEncrypt, RsaDecrypt, RsaKeyGen, Deflate, Inflate
+    };
+    static constexpr size_t PRIMITIVE_COUNT = 9;
+
+    static constexpr uint16_t FIRST_CODE = 600;   // request codes tracked: 600 … 609
+    static constexpr size_t   CODE_COUNT = 10;
+
+#if CLIENT_ENABLE_METRICS
+    static constexpr bool ENABLED = true;
+
+    static Metrics& shared();
+    ~Metrics();
+
+    static uint64_t nowNs();   // monotonic
+
+    void recordPhase(uint16_t code, Phase phase, uint64_t ns);
+    void recordBytes(uint16_t code, uint64_t bytesOut, uint64_t bytesIn);
+    void recordCrypto(Primitive primitive, uint64_t ns, uint64_t bytesIn, uint64_t bytesOut);
+
+    // Request whose response the calling thread received last; set by
+    // Connection, so the parsing that follows is charged to it
+    static uint16_t respondedRequest();
+    static void     setRespondedRequest(uint16_t code);
+
+    // Request of the innermost RequestScope on this thread (0 = none)
+    static uint16_t scopedRequest();
+
+    // Human-readable tables / one JSON document with everything recorded
+    void        print(std::ostream& out) const;
+    std::string toJson() const;
+    void        reset();
+
+    // Rewrites `path` with toJson() every `intervalSec` seconds from a
+    // background thread (replaced atomically); false if already running
+    bool startDump(const std::string& path, unsigned intervalSec);
+    void stopDump();
+    bool dumping() const;
+
+    Metrics(const Metrics&)            = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+private:
+    Metrics();
+
+    struct State;   // histograms and the dump thread, in Metrics.cpp
+    State* state;
+#else
+    static constexpr bool ENABLED = false;
+
+    static Metrics& shared() { static Metrics m; return m; }
+
+    void recordPhase(uint16_t, Phase, uint64_t) {}
+    void recordBytes(uint16_t, uint64_t, uint64_t) {}
+    void recordCrypto(Primitive, uint64_t, uint64_t, uint64_t) {}
+
+    static uint16_t respondedRequest() { return 0; }
+    static void     setRespondedRequest(uint16_t) {}
+    static uint16_t scopedRequest() { return 0; }
+
+    void        print(std::ostream&) const {}
+    std::string toJson() const { return "{}"; }
+    void        reset() {}
+    bool        startDump(const std::string&, unsigned) { return false; }
+    void        stopDump() {}
+    bool        dumping() const { return false; }
+#endif
+};
+
+#if CLIENT_ENABLE_METRICS
+
+// Marks the calling thread as working on `code` until destroyed
+class RequestScope {
+public:
+    explicit RequestScope(uint16_t code);
+    ~RequestScope();
+
+    RequestScope(const RequestScope&)            = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+
+private:
+    uint16_t previous;
+};
+
+// Times one phase of one request
+class PhaseTimer {
+public:
+    PhaseTimer(uint16_t code, Metrics::Phase phase)
+        : code(code), phase(phase), start(Metrics::nowNs()) {}
+    ~PhaseTimer() { Metrics::shared().recordPhase(code, phase, Metrics::nowNs() - start); }
+
+    PhaseTimer(const PhaseTimer&)            = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    uint16_t       code;
+    Metrics::Phase phase;
+    uint64_t       start;
+};
+
+// Times one crypto call; also counts as the Crypto phase of the current
+// request when a RequestScope is active
+class CryptoTimer {
+public:
+    CryptoTimer(Metrics::Primitive primitive, uint64_t bytesIn)
+        : primitive(primitive), bytesIn(bytesIn), start(Metrics::nowNs()) {}
+    ~CryptoTimer();
+
+    void setBytesOut(uint64_t n) { bytesOut = n; }
+    // Time spent outside the primitive (e.g. in a stream's output callback)
+    void exclude(uint64_t ns) { excluded += ns; }
+
+    CryptoTimer(const CryptoTimer&)            = delete;
+    CryptoTimer& operator=(const CryptoTimer&) = delete;
+
+private:
+    Metrics::Primitive primitive;
+    uint64_t           bytesIn;
+    uint64_t           bytesOut = 0;
+    uint64_t           excluded = 0;
+    uint64_t           start;
+};
+
+#else
+
+class RequestScope {
+public:
+    explicit RequestScope(uint16_t) {}
+};
+
+class PhaseTimer {
+public:
+    PhaseTimer(uint16_t, Metrics::Phase) {}
+};
+
+class CryptoTimer {
+public:
+    CryptoTimer(Metrics::Primitive, uint64_t) {}
+    void setBytesOut(uint64_t) {}
+    void exclude(uint64_t) {}
+};
+
+#endif
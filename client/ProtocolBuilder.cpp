@@ -1,162 +1,299 @@
 // ProtocolBuilder.cpp
 #include "ProtocolBuilder.h"
+#include "Metrics.h"
+#include <stdexcept>
+
+// Member lists are sent straight from the vector's storage
+static_assert(sizeof(ClientId) == ClientId::SIZE, "ClientId must be exactly 16 bytes");
 
 // -----------------------------------------------------------------------------
-//  Helpers – little-endian writers
+//  Helpers
 // -----------------------------------------------------------------------------
-static void appendUint16LE(std::vector<uint8_t>& buf, uint16_t v) {
-    buf.push_back(static_cast<uint8_t>( v        & 0xFF));
-    buf.push_back(static_cast<uint8_t>((v >> 8)  & 0xFF));
+static void putId(Frame& f, const ClientId& id) {
+    f.putBytes(id.data(), id.size());
+}
+
+// Fixed-size record written in place into the frame's inline buffer
+template <typename Record, typename... Values>
+static void putRecord(Frame& f, const Values&... values) {
+    Record::write(f.appendInline(Record::SIZE), values...);
 }
 
-static void appendUint32LE(std::vector<uint8_t>& buf, uint32_t v) {
-    buf.push_back(static_cast<uint8_t>( v        & 0xFF));
-    buf.push_back(static_cast<uint8_t>((v >> 8)  & 0xFF));
-    buf.push_back(static_cast<uint8_t>((v >> 16) & 0xFF));
-    buf.push_back(static_cast<uint8_t>((v >> 24) & 0xFF));
+static uint8_t messageType(uint8_t type, bool compressed) {
+    return compressed ? static_cast<uint8_t>(type | wire::MSG_COMPRESSED) : type;
+}
+
+static void putIdList(Frame& f, const std::vector<ClientId>& ids) {
+    f.putBorrowed(reinterpret_cast<const uint8_t*>(ids.data()),
+                  ids.size() * ClientId::SIZE);
 }
 
 // -----------------------------------------------------------------------------
 //  23-byte header builder
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildHeader(
-        const std::vector<uint8_t>& clientId,
-        uint8_t  version,
-        uint16_t code,
-        uint32_t payloadSize)
-{
-    std::vector<uint8_t> header;
-    header.insert(header.end(), clientId.begin(), clientId.end()); // 16
-    header.push_back(version);                                     // 1
-    appendUint16LE(header, code);                                  // 2
-    appendUint32LE(header, payloadSize);                           // 4
+Frame ProtocolBuilder::buildHeader(
+        const ClientId&             clientId,
+        uint8_t                     version,
+        uint16_t                    code,
+        uint32_t                    payloadSize)
+{
+    Frame header;
+    putRecord<wire::RequestHeader>(header, clientId, version, code, payloadSize);
     return header;                                                 // =23 bytes
 }
 
 // -----------------------------------------------------------------------------
 // 600 – Register
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildRegisterRequest(
-        const std::string& username,
+Frame ProtocolBuilder::buildRegisterRequest(
+        const std::string&          username,
         const std::vector<uint8_t>& publicKeyDER)
 {
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), username.begin(), username.end());
-    payload.push_back(0);                               // null-terminator
-    payload.insert(payload.end(), publicKeyDER.begin(), publicKeyDER.end());
-
-    auto header = buildHeader(std::vector<uint8_t>(16, 0), 1, 600,
-                              static_cast<uint32_t>(payload.size()));
-    header.insert(header.end(), payload.begin(), payload.end());
-    return header;
+    PhaseTimer timer(600, Metrics::Phase::Serialize);
+    /* payload = [username][0][publicKeyDER] */
+    auto msg = buildHeader(ClientId{}, 1, 600,
+                           static_cast<uint32_t>(username.size() + 1 + publicKeyDER.size()));
+    msg.putBorrowed(reinterpret_cast<const uint8_t*>(username.data()), username.size());
+    msg.putUint8(0);                                    // null-terminator
+    msg.putBorrowed(publicKeyDER.data(), publicKeyDER.size());
+    return msg;
 }
 
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildListRequest(
-        const std::vector<uint8_t>& clientId)
+Frame ProtocolBuilder::buildListRequest(
+        const ClientId&             clientId)
 {
+    PhaseTimer timer(601, Metrics::Phase::Serialize);
     return buildHeader(clientId, 1, 601, 0);
 }
 
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildGetPublicKeyRequest(
-        const std::vector<uint8_t>& clientId,
-        const std::vector<uint8_t>& targetId)
+// 608 – Clients list changes since a registry version
+//    payload = sinceVersion (8)
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildListDeltaRequest(
+        const ClientId&             clientId,
+        uint64_t                    sinceVersion)
+{
+    PhaseTimer timer(608, Metrics::Phase::Serialize);
+    auto msg = buildHeader(clientId, 1, 608, wire::ListDeltaBody::SIZE);
+    putRecord<wire::ListDeltaBody>(msg, sinceVersion);
+    return msg;
+}
+
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildGetPublicKeyRequest(
+        const ClientId&             clientId,
+        const ClientId&             targetId)
 {
-    auto header = buildHeader(clientId, 1, 602,
-                              static_cast<uint32_t>(targetId.size()));
-    header.insert(header.end(), targetId.begin(), targetId.end());
-    return header;
+    PhaseTimer timer(602, Metrics::Phase::Serialize);
+    auto msg = buildHeader(clientId, 1, 602, ClientId::SIZE);
+    putId(msg, targetId);
+    return msg;
 }
 
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildFetchMessagesRequest(
-        const std::vector<uint8_t>& clientId)
+// 607 – Get public keys for many clients in one round trip
+//    payload = count (2) + count × targetId (16)
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildGetPublicKeysRequest(
+        const ClientId&              clientId,
+        const std::vector<ClientId>& targetIds)
 {
+    PhaseTimer timer(607, Metrics::Phase::Serialize);
+    if (targetIds.size() > 0xFFFF)
+        throw std::runtime_error("Too many IDs in one public key request");
+
+    auto msg = buildHeader(clientId, 1, 607,
+                           static_cast<uint32_t>(2 + 16 * targetIds.size()));
+    msg.putUint16LE(static_cast<uint16_t>(targetIds.size()));           // count
+    putIdList(msg, targetIds);                                           // 16 B each
+    return msg;
+}
+
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildFetchMessagesRequest(
+        const ClientId&             clientId)
+{
+    PhaseTimer timer(604, Metrics::Phase::Serialize);
     return buildHeader(clientId, 1, 604, 0);
 }
 
 // -----------------------------------------------------------------------------
-// 603 + msgType = 1  →  Request symmetric key (no content)
+// 605 – Fetch one page of messages
+//    payload = maxBytes (4) + maxCount (4)
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildRequestSymKey(
-        const std::vector<uint8_t>& clientId,
-        const std::vector<uint8_t>& targetId)
+Frame ProtocolBuilder::buildFetchPageRequest(
+        const ClientId&             clientId,
+        uint32_t                    maxBytes,
+        uint32_t                    maxCount)
 {
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), targetId.begin(), targetId.end()); // 16
-    payload.push_back(1);                                            // type
-    appendUint32LE(payload, 0);                                      // size=0
+    PhaseTimer timer(605, Metrics::Phase::Serialize);
+    auto msg = buildHeader(clientId, 1, 605, wire::FetchPageBody::SIZE);
+    putRecord<wire::FetchPageBody>(msg, maxBytes, maxCount);
+    return msg;
+}
+
+// -----------------------------------------------------------------------------
+// 609 – Wait for messages (long poll)
+//    payload = timeoutMs (4) + maxBytes (4) + maxCount (4)
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildWaitMessagesRequest(
+        const ClientId&             clientId,
+        uint32_t                    timeoutMs,
+        uint32_t                    maxBytes,
+        uint32_t                    maxCount)
+{
+    PhaseTimer timer(609, Metrics::Phase::Serialize);
+    auto msg = buildHeader(clientId, 1, 609, wire::WaitMessagesBody::SIZE);
+    putRecord<wire::WaitMessagesBody>(msg, timeoutMs, maxBytes, maxCount);
+    return msg;
+}
 
-    auto header = buildHeader(clientId, 1, 603,
-                              static_cast<uint32_t>(payload.size()));
-    header.insert(header.end(), payload.begin(), payload.end());
-    return header;
+// -----------------------------------------------------------------------------
+// 603 + msgType = 1  →  Request symmetric key (no content)
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildRequestSymKey(
+        const ClientId&             clientId,
+        const ClientId&             targetId)
+{
+    PhaseTimer timer(603, Metrics::Phase::Serialize);
+    auto msg = buildHeader(clientId, 1, 603, wire::MessageBody::SIZE);
+    putRecord<wire::MessageBody>(msg, targetId, uint8_t{1}, uint32_t{0});   // size=0
+    return msg;
 }
 
 // -----------------------------------------------------------------------------
 // 603 + msgType = 2  →  Send symmetric key
 //    payload = targetId (16) + 2 + size (4) + encryptedSymKey
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildSendSymKeyRequest(
-        const std::vector<uint8_t>& clientId,
-        const std::vector<uint8_t>& targetId,
+Frame ProtocolBuilder::buildSendSymKeyRequest(
+        const ClientId&             clientId,
+        const ClientId&             targetId,
         const std::vector<uint8_t>& encryptedSymKey)
 {
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), targetId.begin(), targetId.end());     // 16
-    payload.push_back(2);                                               // type
-    appendUint32LE(payload,
-                   static_cast<uint32_t>(encryptedSymKey.size()));      // size
-    payload.insert(payload.end(),
-                   encryptedSymKey.begin(), encryptedSymKey.end());     // data
-
-    auto header = buildHeader(clientId, 1, 603,
-                              static_cast<uint32_t>(payload.size()));
-    header.insert(header.end(), payload.begin(), payload.end());
-    return header;
+    PhaseTimer timer(603, Metrics::Phase::Serialize);
+    const auto size = static_cast<uint32_t>(encryptedSymKey.size());
+    auto msg = buildHeader(clientId, 1, 603, wire::MessageBody::SIZE + size);
+    putRecord<wire::MessageBody>(msg, targetId, uint8_t{2}, size);
+    msg.putBorrowed(encryptedSymKey.data(), encryptedSymKey.size());    // data
+    return msg;
 }
 
 // -----------------------------------------------------------------------------
 // 603 + msgType = 3  →  Send text message (IV is all-zero, so we send cipher only)
 //    payload = targetId (16) + 3 + size (4) + ciphertext
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildSendTextRequest(
-        const std::vector<uint8_t>& clientId,
-        const std::vector<uint8_t>& targetId,
-        const std::vector<uint8_t>& ciphertext)
+Frame ProtocolBuilder::buildSendTextRequest(
+        const ClientId&             clientId,
+        const ClientId&             targetId,
+        const std::vector<uint8_t>& ciphertext,
+        bool                        compressed)
 {
+    PhaseTimer timer(603, Metrics::Phase::Serialize);
     /* payload = [toId][msgType=3][size][ciphertext] */
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), targetId.begin(), targetId.end());     // 16 B
-    payload.push_back(3);                                               // msgType
-    appendUint32LE(payload, static_cast<uint32_t>(ciphertext.size()));   // size
-    payload.insert(payload.end(), ciphertext.begin(), ciphertext.end()); // data
-
-    auto header = buildHeader(clientId, 1, 603,
-                              static_cast<uint32_t>(payload.size()));
-    header.insert(header.end(), payload.begin(), payload.end());
-    return header;
+    const auto size = static_cast<uint32_t>(ciphertext.size());
+    auto msg = buildHeader(clientId, 1, 603, wire::MessageBody::SIZE + size);
+    putRecord<wire::MessageBody>(msg, targetId, messageType(3, compressed), size);
+    msg.putBorrowed(ciphertext.data(), ciphertext.size());               // data
+    return msg;
 }
 
 // -----------------------------------------------------------------------------
 // 603 + msgType = 4  →  Send file (cipher only, IV = 0 on both sides)
 //    payload = targetId (16) + 4 + size (4) + cipherData
 // -----------------------------------------------------------------------------
-std::vector<uint8_t> ProtocolBuilder::buildSendFileRequest(
-        const std::vector<uint8_t>& clientId,
-        const std::vector<uint8_t>& targetId,
-        const std::vector<uint8_t>& cipherData)
+Frame ProtocolBuilder::buildSendFileRequest(
+        const ClientId&             clientId,
+        const ClientId&             targetId,
+        const std::vector<uint8_t>& cipherData,
+        bool                        compressed)
 {
+    PhaseTimer timer(603, Metrics::Phase::Serialize);
     /* payload = [toId][msgType=4][size][cipherData] */
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), targetId.begin(), targetId.end());     // 16 B
-    payload.push_back(4);                                               // msgType
-    appendUint32LE(payload, static_cast<uint32_t>(cipherData.size()));   // size
-    payload.insert(payload.end(), cipherData.begin(), cipherData.end()); // data
-
-    auto header = buildHeader(clientId, 1, 603,
-                              static_cast<uint32_t>(payload.size()));
-    header.insert(header.end(), payload.begin(), payload.end());
-    return header;
+    const auto size = static_cast<uint32_t>(cipherData.size());
+    auto msg = buildHeader(clientId, 1, 603, wire::MessageBody::SIZE + size);
+    putRecord<wire::MessageBody>(msg, targetId, messageType(4, compressed), size);
+    msg.putBorrowed(cipherData.data(), cipherData.size());               // data
+    return msg;
+}
+
+// -----------------------------------------------------------------------------
+// 603 + msgType = 4, head only – the ciphertext is streamed after it
+//    payload = targetId (16) + 4 + size (4)   [+ cipherSize bytes sent later]
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildSendFileHead(
+        const ClientId&             clientId,
+        const ClientId&             targetId,
+        uint32_t                    cipherSize,
+        bool                        compressed)
+{
+    PhaseTimer timer(603, Metrics::Phase::Serialize);
+    auto head = buildHeader(clientId, 1, 603, wire::MessageBody::SIZE + cipherSize);
+    putRecord<wire::MessageBody>(head, targetId, messageType(4, compressed), cipherSize);
+    return head;
+}
+
+// -----------------------------------------------------------------------------
+// 603 + msgType = 5 – group key for one member
+//    content = groupId (16) + nameLen (1) + name + count (2)
+//              + count × memberId (16) + RSA(group key)
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildSendGroupKeyRequest(
+        const ClientId&              clientId,
+        const ClientId&              targetId,
+        const ClientId&              groupId,
+        const std::string&           groupName,
+        const std::vector<ClientId>& members,
+        const std::vector<uint8_t>&  encryptedGroupKey)
+{
+    PhaseTimer timer(603, Metrics::Phase::Serialize);
+    if (groupName.size() > 255)
+        throw std::runtime_error("Group name too long");
+    if (members.size() > 0xFFFF)
+        throw std::runtime_error("Too many group members");
+
+    const size_t contentSize = 16 + 1 + groupName.size() + 2 + 16 * members.size()
+                               + encryptedGroupKey.size();
+
+    /* payload = [toId][msgType=5][size][content] */
+    auto msg = buildHeader(clientId, 1, 603,
+                           static_cast<uint32_t>(wire::MessageBody::SIZE + contentSize));
+    putRecord<wire::MessageBody>(msg, targetId, uint8_t{5}, static_cast<uint32_t>(contentSize));
+    putId(msg, groupId);                                                 // 16 B
+    msg.putUint8(static_cast<uint8_t>(groupName.size()));                // nameLen
+    msg.putBorrowed(reinterpret_cast<const uint8_t*>(groupName.data()),
+                    groupName.size());                                   // name
+    msg.putUint16LE(static_cast<uint16_t>(members.size()));              // count
+    putIdList(msg, members);                                             // 16 B each
+    msg.putBorrowed(encryptedGroupKey.data(), encryptedGroupKey.size()); // key
+    return msg;
+}
+
+// -----------------------------------------------------------------------------
+// 606 – group message (one ciphertext, queued by the server for every member)
+//    payload = groupId (16) + count (2) + count × memberId (16)
+//              + 6 + size (4) + ciphertext
+// -----------------------------------------------------------------------------
+Frame ProtocolBuilder::buildSendGroupTextRequest(
+        const ClientId&              clientId,
+        const ClientId&              groupId,
+        const std::vector<ClientId>& members,
+        const std::vector<uint8_t>&  ciphertext)
+{
+    PhaseTimer timer(606, Metrics::Phase::Serialize);
+    if (members.size() > 0xFFFF)
+        throw std::runtime_error("Too many group members");
+
+    const uint32_t payloadSize = static_cast<uint32_t>(
+        16 + 2 + 16 * members.size() + 1 + 4 + ciphertext.size());
+
+    auto msg = buildHeader(clientId, 1, 606, payloadSize);
+    putId(msg, groupId);                                                 // 16 B
+    msg.putUint16LE(static_cast<uint16_t>(members.size()));              // count
+    putIdList(msg, members);                                             // 16 B each
+    msg.putUint8(6);                                                     // msgType
+    msg.putUint32LE(static_cast<uint32_t>(ciphertext.size()));           // size
+    msg.putBorrowed(ciphertext.data(), ciphertext.size());               // data
+    return msg;
 }
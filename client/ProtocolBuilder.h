@@ -3,54 +3,126 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include "ClientId.h"
+#include "Frame.h"
+#include "ProtocolSchema.h"
 
+// Every builder returns a Frame: header and fixed fields in the frame's
+// inline buffer, while vector / string arguments (keys, ciphertext, names,
+// member lists) are referenced, not copied. Keep those arguments alive and
+// unchanged until the frame has been sent.
 class ProtocolBuilder {
 public:
+    static constexpr size_t HEADER_SIZE = wire::RequestHeader::SIZE;
+
     /* 23-byte header helper */
-    static std::vector<uint8_t> buildHeader(
-            const std::vector<uint8_t>& clientId,
+    static Frame buildHeader(
+            const ClientId&             clientId,
             uint8_t                     version,
             uint16_t                    code,
             uint32_t                    payloadSize);
 
     /* 600 – register */
-    static std::vector<uint8_t> buildRegisterRequest(
+    static Frame buildRegisterRequest(
             const std::string&          username,
             const std::vector<uint8_t>& publicKeyDER);
 
     /* 601 – list clients */
-    static std::vector<uint8_t> buildListRequest(
-            const std::vector<uint8_t>& clientId);
+    static Frame buildListRequest(
+            const ClientId&             clientId);
+
+    /* 608 – clients list changes since `sinceVersion` (0 = full list)
+       payload = [sinceVersion (8)] */
+    static Frame buildListDeltaRequest(
+            const ClientId&             clientId,
+            uint64_t                    sinceVersion);
 
     /* 602 – get public key */
-    static std::vector<uint8_t> buildGetPublicKeyRequest(
-            const std::vector<uint8_t>& clientId,
-            const std::vector<uint8_t>& targetId);
+    static Frame buildGetPublicKeyRequest(
+            const ClientId&             clientId,
+            const ClientId&             targetId);
+
+    /* 607 – get many public keys at once
+       payload = [count (2)][count × targetId (16)] */
+    static Frame buildGetPublicKeysRequest(
+            const ClientId&              clientId,
+            const std::vector<ClientId>& targetIds);
 
     /* 604 – fetch messages */
-    static std::vector<uint8_t> buildFetchMessagesRequest(
-            const std::vector<uint8_t>& clientId);
+    static Frame buildFetchMessagesRequest(
+            const ClientId&             clientId);
+
+    /* 605 – fetch one page of messages
+       payload = [maxBytes (4)][maxCount (4)]; the server always returns at
+       least one pending message, even if it alone exceeds maxBytes */
+    static Frame buildFetchPageRequest(
+            const ClientId&             clientId,
+            uint32_t                    maxBytes,
+            uint32_t                    maxCount);
+
+    /* 609 – long-poll for messages
+       payload = [timeoutMs (4)][maxBytes (4)][maxCount (4)]; answered like
+       605 (as 2109) once a message is queued for us, or empty after
+       timeoutMs (the server caps it) */
+    static Frame buildWaitMessagesRequest(
+            const ClientId&             clientId,
+            uint32_t                    timeoutMs,
+            uint32_t                    maxBytes,
+            uint32_t                    maxCount);
 
     /* 603 – msgType 1 : request symmetric key */
-    static std::vector<uint8_t> buildRequestSymKey(
-            const std::vector<uint8_t>& clientId,
-            const std::vector<uint8_t>& targetId);
+    static Frame buildRequestSymKey(
+            const ClientId&             clientId,
+            const ClientId&             targetId);
 
     /* 603 – msgType 2 : send symmetric key */
-    static std::vector<uint8_t> buildSendSymKeyRequest(
-            const std::vector<uint8_t>& clientId,
-            const std::vector<uint8_t>& targetId,
+    static Frame buildSendSymKeyRequest(
+            const ClientId&             clientId,
+            const ClientId&             targetId,
             const std::vector<uint8_t>& encryptedSymKey);
 
-    /* 603 – msgType 3 : send text (cipher only, IV = 0) */
-    static std::vector<uint8_t> buildSendTextRequest(
-            const std::vector<uint8_t>& clientId,
-            const std::vector<uint8_t>& targetId,
-            const std::vector<uint8_t>& ciphertext);
+    /* 603 – msgType 3 : send text (cipher only, IV = 0)
+       `compressed` sets wire::MSG_COMPRESSED (plaintext was deflated) */
+    static Frame buildSendTextRequest(
+            const ClientId&             clientId,
+            const ClientId&             targetId,
+            const std::vector<uint8_t>& ciphertext,
+            bool                        compressed = false);
 
     /* 603 – msgType 4 : send file (cipher only, IV = 0) */
-    static std::vector<uint8_t> buildSendFileRequest(
-            const std::vector<uint8_t>& fromId,
-            const std::vector<uint8_t>& toId,
-            const std::vector<uint8_t>& cipherData);
+    static Frame buildSendFileRequest(
+            const ClientId&             fromId,
+            const ClientId&             toId,
+            const std::vector<uint8_t>& cipherData,
+            bool                        compressed = false);
+
+    /* 603 – msgType 4 without the data: header + [toId][4][size], for
+       streaming `cipherSize` bytes of ciphertext behind it */
+    static Frame buildSendFileHead(
+            const ClientId&             fromId,
+            const ClientId&             toId,
+            uint32_t                    cipherSize,
+            bool                        compressed = false);
+
+    /* 603 – msgType 5 : group key for one member
+       content = [groupId (16)][nameLen (1)][name][count (2)]
+                 [count × memberId (16)][RSA(group key)] */
+    static Frame buildSendGroupKeyRequest(
+            const ClientId&              clientId,
+            const ClientId&              targetId,
+            const ClientId&              groupId,
+            const std::string&           groupName,
+            const std::vector<ClientId>& members,
+            const std::vector<uint8_t>&  encryptedGroupKey);
+
+    /* 606 – group message, fanned out by the server
+       payload = [groupId (16)][count (2)][count × memberId (16)]
+                 [msgType=6][size (4)][ciphertext]
+       `members` must include the sender (the server rejects it otherwise,
+       and skips the sender when queueing); at most 1024 IDs */
+    static Frame buildSendGroupTextRequest(
+            const ClientId&              clientId,
+            const ClientId&              groupId,
+            const std::vector<ClientId>& members,
+            const std::vector<uint8_t>&  ciphertext);
 };
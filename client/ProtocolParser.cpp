@@ -1,31 +1,180 @@
 #include "ProtocolParser.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include <cstring>
 
-ParsedMessage ProtocolParser::parse(const std::vector<uint8_t> &raw) {
-    if (raw.size() < 7) {
-        throw std::runtime_error("Raw response too short");
-    }
+using wire::ClientEntry;
+using wire::ListDeltaHead;
+using wire::MessageEntry;
+using wire::PublicKeyEntry;
 
-    ParsedMessage msg;
+static ClientRecord readClientRecord(const uint8_t* p) {
+    ClientRecord rec;
+    rec.clientId = ClientEntry::get<ClientEntry::CLIENT_ID>(p);
+    const char* name = reinterpret_cast<const char*>(ClientEntry::get<ClientEntry::NAME>(p));
+    size_t len = 0;
+    while (len < 255 && name[len] != '\0') ++len;
+    rec.name.assign(name, len);
+    return rec;
+}
+
+ResponseHeader ProtocolParser::parseHeader(const uint8_t* raw) {
+    using H = wire::ResponseHeader;
+    ResponseHeader h;
+    h.version     = H::get<H::VERSION>(raw);
+    h.code        = H::get<H::CODE>(raw);
+    h.payloadSize = H::get<H::PAYLOAD_SIZE>(raw);
+    return h;
+}
 
-    // 0: Version
-    msg.version = raw[0];
+MessageEntryHeader ProtocolParser::parseMessageEntryHeader(const uint8_t* raw) {
+    PhaseTimer timer(Metrics::respondedRequest(), Metrics::Phase::Parse);
+    MessageEntryHeader e;
+    e.fromId = MessageEntry::get<MessageEntry::FROM_ID>(raw);
+    e.msgId  = MessageEntry::get<MessageEntry::MSG_ID>(raw);
+    e.type   = MessageEntry::get<MessageEntry::TYPE>(raw);
+    e.size   = MessageEntry::get<MessageEntry::CONTENT_SIZE>(raw);
+    return e;
+}
 
-    // 1–2: Code (little-endian)
-    msg.code = static_cast<uint16_t>(raw[1]) | (static_cast<uint16_t>(raw[2]) << 8);
+ParsedView ProtocolParser::parseView(const uint8_t* raw, size_t size) {
+    PhaseTimer timer(Metrics::respondedRequest(), Metrics::Phase::Parse);
+    if (size < RESPONSE_HEADER_SIZE) {
+        throw std::runtime_error("Raw response too short");
+    }
 
-    // 3–6: Payload size (little-endian)
-    uint32_t payloadSize = static_cast<uint32_t>(raw[3]) |
-                           (static_cast<uint32_t>(raw[4]) << 8) |
-                           (static_cast<uint32_t>(raw[5]) << 16) |
-                           (static_cast<uint32_t>(raw[6]) << 24);
+    ResponseHeader h = parseHeader(raw);
 
     // Validate total size
-    if (raw.size() != 7 + payloadSize) {
+    if (size != RESPONSE_HEADER_SIZE + static_cast<size_t>(h.payloadSize)) {
         throw std::runtime_error("Payload size mismatch in response");
     }
 
-    // 7…: Payload
-    msg.payload.assign(raw.begin() + 7, raw.end());
+    ParsedView msg;
+    msg.version = h.version;
+    msg.code    = h.code;
+    msg.payload = ByteView(raw + RESPONSE_HEADER_SIZE, h.payloadSize);
+    return msg;
+}
 
+ParsedView ProtocolParser::parseView(const std::vector<uint8_t>& raw) {
+    return parseView(raw.data(), raw.size());
+}
+
+ParsedMessage ProtocolParser::parse(const std::vector<uint8_t> &raw) {
+    ParsedView view = parseView(raw);
+
+    ParsedMessage msg;
+    msg.version = view.version;
+    msg.code    = view.code;
+    msg.payload = BufferPool::shared().acquire(view.payload.size());
+    if (!view.payload.empty()) {
+        std::memcpy(msg.payload.data(), view.payload.data(), view.payload.size());
+    }
     return msg;
 }
+
+GroupKeyContent ProtocolParser::parseGroupKeyContent(ByteView content) {
+    PhaseTimer timer(Metrics::respondedRequest(), Metrics::Phase::Parse);
+    GroupKeyContent g;
+    size_t off = 0;
+
+    ByteView id = content.sub(off, 16);
+    g.groupId = ClientId(id.data());
+    off += 16;
+
+    size_t nameLen = content.sub(off, 1)[0];
+    off += 1;
+    ByteView name = content.sub(off, nameLen);
+    g.name.assign(name.begin(), name.end());
+    off += nameLen;
+
+    ByteView cnt = content.sub(off, 2);
+    size_t count = wire::U16::read(cnt.data());
+    off += 2;
+
+    ByteView members = content.sub(off, 16 * count);
+    g.members.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        ByteView m = members.sub(16 * i, 16);
+        g.members.emplace_back(m.data());
+    }
+    off += 16 * count;
+
+    ByteView key = content.sub(off, content.size() - off);
+    if (key.empty()) {
+        throw std::runtime_error("Group key message carries no key");
+    }
+    g.encryptedKey.assign(key.begin(), key.end());
+    return g;
+}
+
+std::vector<PublicKeyRecord> ProtocolParser::parsePublicKeys(ByteView payload) {
+    PhaseTimer timer(Metrics::respondedRequest(), Metrics::Phase::Parse);
+    ByteView cnt = payload.sub(0, 2);
+    size_t count = wire::U16::read(cnt.data());
+    size_t off = 2;
+
+    std::vector<PublicKeyRecord> records(count);
+    for (auto& rec : records) {
+        PublicKeyEntry::Reader head(payload.data() + off, payload.size() - off);
+        rec.clientId  = head.get<PublicKeyEntry::CLIENT_ID>();
+        size_t keyLen = head.get<PublicKeyEntry::KEY_LEN>();
+        off += PublicKeyEntry::SIZE;
+
+        ByteView key = payload.sub(off, keyLen);
+        rec.publicKeyDER.assign(key.begin(), key.end());
+        off += keyLen;
+    }
+    if (off != payload.size()) {
+        throw std::runtime_error("Trailing bytes in public key list");
+    }
+    return records;
+}
+
+// Untimed body of parseClientList, shared with parseClientListDelta
+static std::vector<ClientRecord> readClientList(ByteView payload) {
+    if (payload.size() % ClientEntry::SIZE != 0) {
+        throw std::runtime_error("Malformed clients list payload");
+    }
+    size_t count = payload.size() / ClientEntry::SIZE;
+    std::vector<ClientRecord> records;
+    records.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        records.push_back(readClientRecord(payload.data() + i * ClientEntry::SIZE));
+    }
+    return records;
+}
+
+std::vector<ClientRecord> ProtocolParser::parseClientList(ByteView payload) {
+    PhaseTimer timer(Metrics::respondedRequest(), Metrics::Phase::Parse);
+    return readClientList(payload);
+}
+
+ClientListDelta ProtocolParser::parseClientListDelta(ByteView payload) {
+    PhaseTimer timer(Metrics::respondedRequest(), Metrics::Phase::Parse);
+    ClientListDelta d;
+    ListDeltaHead::Reader head(payload.data(), payload.size());
+    d.version    = head.get<ListDeltaHead::VERSION>();
+    d.full       = head.get<ListDeltaHead::FULL>() != 0;
+    size_t added = head.get<ListDeltaHead::ADDED_COUNT>();
+    size_t off   = ListDeltaHead::SIZE;
+
+    if (added > (payload.size() - off) / CLIENT_RECORD_SIZE) {
+        throw std::runtime_error("Malformed clients list delta");
+    }
+    d.added = readClientList(payload.sub(off, added * CLIENT_RECORD_SIZE));
+    off += added * CLIENT_RECORD_SIZE;
+
+    size_t removed = wire::U32::read(payload.sub(off, 4).data());
+    off += 4;
+    if (removed > (payload.size() - off) / 16 || off + removed * 16 != payload.size()) {
+        throw std::runtime_error("Malformed clients list delta");
+    }
+    d.removed.reserve(removed);
+    for (size_t i = 0; i < removed; ++i) {
+        const uint8_t* id = payload.data() + off + i * 16;
+        d.removed.emplace_back(id);
+    }
+    return d;
+}
@@ -1,20 +1,127 @@
 // ProtocolParser.h
 #pragma once
 #include <vector>
+#include <string>
 #include <cstdint>
 #include <stdexcept>
+#include "ClientId.h"
+#include "ProtocolSchema.h"
 
 // ParsedMessage holds header fields and payload
 struct ParsedMessage {
     std::vector<uint8_t> clientId; // 16 bytes
     uint8_t              version;  // 1 byte
     uint16_t             code;     // 2 bytes
-    std::vector<uint8_t> payload;  // payloadSize bytes
+    std::vector<uint8_t> payload;  // payloadSize bytes (from BufferPool::shared())
+};
+
+// ByteView is a non-owning (pointer, length) window over someone else's bytes
+class ByteView {
+public:
+    ByteView() = default;
+    ByteView(const uint8_t* data, size_t size) : ptr(data), len(size) {}
+
+    const uint8_t* data()  const { return ptr; }
+    size_t         size()  const { return len; }
+    bool           empty() const { return len == 0; }
+    const uint8_t* begin() const { return ptr; }
+    const uint8_t* end()   const { return ptr + len; }
+    uint8_t operator[](size_t i) const { return ptr[i]; }
+
+    // Bounds-checked sub-range; throws runtime_error if it overruns the view
+    ByteView sub(size_t offset, size_t count) const {
+        if (offset > len || count > len - offset) {
+            throw std::runtime_error("ByteView range out of bounds");
+        }
+        return { ptr + offset, count };
+    }
+
+private:
+    const uint8_t* ptr = nullptr;
+    size_t         len = 0;
+};
+
+// ParsedView holds header fields and a view of the payload inside the parsed
+// buffer; it is only valid while that buffer is alive and unchanged
+struct ParsedView {
+    uint8_t  version;
+    uint16_t code;
+    ByteView payload;
+};
+
+// Response header alone (for responses whose payload is streamed)
+struct ResponseHeader {
+    uint8_t  version;
+    uint16_t code;
+    uint32_t payloadSize;
+};
+
+// Fixed part of one 2104 entry: [16 fromId][4 msgId][1 type][4 size]
+struct MessageEntryHeader {
+    ClientId             fromId;
+    uint32_t             msgId;
+    uint8_t              type;
+    uint32_t             size;
+};
+
+// One clients-list record: [16 clientId][255 name, NUL-padded]
+struct ClientRecord {
+    ClientId    clientId;
+    std::string name;
+};
+
+// 2108 payload: [8 version][1 full][4 n][n × record][4 m][m × 16 clientId]
+struct ClientListDelta {
+    uint64_t                  version = 0;
+    bool                      full    = false;  // `added` replaces the whole list
+    std::vector<ClientRecord> added;
+    std::vector<ClientId>     removed;
+};
+
+// One record of a 2107 response: [16 clientId][2 keyLen][key]
+struct PublicKeyRecord {
+    ClientId             clientId;
+    std::vector<uint8_t> publicKeyDER;
+};
+
+// Content of a type-5 (group key) message:
+// [16 groupId][1 nameLen][name][2 count][count × 16 memberId][RSA(group key)]
+struct GroupKeyContent {
+    ClientId              groupId;
+    std::string           name;
+    std::vector<ClientId> members;
+    std::vector<uint8_t>  encryptedKey;
 };
 
 class ProtocolParser {
 public:
+    static constexpr size_t RESPONSE_HEADER_SIZE      = wire::ResponseHeader::SIZE;
+    static constexpr size_t MESSAGE_ENTRY_HEADER_SIZE = wire::MessageEntry::SIZE;
+    static constexpr size_t CLIENT_RECORD_SIZE        = wire::ClientEntry::SIZE;
+
+    // Decodes the first RESPONSE_HEADER_SIZE bytes of a response
+    static ResponseHeader parseHeader(const uint8_t* raw);
+
+    // Decodes MESSAGE_ENTRY_HEADER_SIZE bytes at `raw`
+    static MessageEntryHeader parseMessageEntryHeader(const uint8_t* raw);
+
     // Parses a raw buffer (header + payload) into a ParsedMessage.
     // Throws runtime_error if too short or size mismatch.
     static ParsedMessage parse(const std::vector<uint8_t>& raw);
+
+    // Same checks as parse(), without copying the payload
+    static ParsedView parseView(const uint8_t* raw, size_t size);
+    static ParsedView parseView(const std::vector<uint8_t>& raw);
+
+    // Decodes a 2101 payload (a run of client records); throws runtime_error if malformed
+    static std::vector<ClientRecord> parseClientList(ByteView payload);
+
+    // Decodes a 2108 payload; throws runtime_error if malformed
+    static ClientListDelta parseClientListDelta(ByteView payload);
+
+    // Decodes a 2107 payload: [2 count][count × record]; throws runtime_error if malformed
+    static std::vector<PublicKeyRecord> parsePublicKeys(ByteView payload);
+
+    // Decodes the content of a type-5 message; throws runtime_error if malformed
+    static GroupKeyContent parseGroupKeyContent(ByteView content);
 };
@@ -0,0 +1,209 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include "ClientId.h"
+
+// Compile-time description of the fixed-size wire records. Each record is a
+// list of field types; offsets and the total size are constants, so the
+// generated writers and readers are straight-line loads and stores at fixed
+// offsets – the same code as the hand-written shifts, written once.
+//
+//   wire::RequestHeader::write(buf, clientId, version, code, payloadSize);
+//   uint16_t code = wire::ResponseHeader::get<wire::ResponseHeader::CODE>(raw);
+//   wire::MessageEntry::Reader e(p, available);   // throws if truncated
+//
+// All integers are little-endian.
+namespace wire {
+
+/* ─── Field types ──────────────────────────────── */
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+constexpr bool HOST_LITTLE_ENDIAN = true;
+#else
+constexpr bool HOST_LITTLE_ENDIAN = false;
+#endif
+
+template <typename T>
+struct UIntLE {
+    using value_type = T;
+    static constexpr size_t WIDTH = sizeof(T);
+
+    // On little-endian hosts a field is one unaligned load/store; compilers
+    // don't reliably merge the portable byte loop into that
+    static void write(uint8_t* p, T v) {
+        if constexpr (HOST_LITTLE_ENDIAN) {
+            std::memcpy(p, &v, WIDTH);
+        } else {
+            for (size_t i = 0; i < WIDTH; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+    }
+    static T read(const uint8_t* p) {
+        T v = 0;
+        if constexpr (HOST_LITTLE_ENDIAN) {
+            std::memcpy(&v, p, WIDTH);
+        } else {
+            for (size_t i = 0; i < WIDTH; ++i) v |= static_cast<T>(static_cast<T>(p[i]) << (8 * i));
+        }
+        return v;
+    }
+};
+
+using U8  = UIntLE<uint8_t>;
+using U16 = UIntLE<uint16_t>;
+using U32 = UIntLE<uint32_t>;
+using U64 = UIntLE<uint64_t>;
+
+struct Id {
+    using value_type = ClientId;
+    static constexpr size_t WIDTH = ClientId::SIZE;
+
+    static void     write(uint8_t* p, const ClientId& v) { std::memcpy(p, v.data(), WIDTH); }
+    static ClientId read(const uint8_t* p)                { return ClientId(p); }
+};
+
+// N raw bytes; read() returns a pointer into the buffer (no copy)
+template <size_t N>
+struct Bytes {
+    using value_type = const uint8_t*;
+    static constexpr size_t WIDTH = N;
+
+    static void           write(uint8_t* p, const uint8_t* v) { std::memcpy(p, v, WIDTH); }
+    static const uint8_t* read(const uint8_t* p)              { return p; }
+};
+
+/* ─── Records ──────────────────────────────────── */
+
+template <typename... Fields>
+struct Record {
+    static constexpr size_t SIZE = (Fields::WIDTH + ... + 0);
+
+    template <size_t I>
+    using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    template <size_t I>
+    static constexpr size_t offset() {
+        constexpr size_t widths[] = { Fields::WIDTH... };
+        size_t off = 0;
+        for (size_t k = 0; k < I; ++k) off += widths[k];
+        return off;
+    }
+
+    // Writes every field, in order, to out[0, SIZE)
+    static void write(uint8_t* out, const typename Fields::value_type&... values) {
+        writeFields(out, std::index_sequence_for<Fields...>{}, values...);
+    }
+
+    // Unchecked read of field I; the caller guarantees SIZE bytes at `p`
+    template <size_t I>
+    static typename Field<I>::value_type get(const uint8_t* p) {
+        return Field<I>::read(p + offset<I>());
+    }
+
+    // Unchecked write of field I alone
+    template <size_t I>
+    static void set(uint8_t* p, const typename Field<I>::value_type& v) {
+        Field<I>::write(p + offset<I>(), v);
+    }
+
+    // Bounds-checked, zero-copy view of one record inside a larger buffer
+    class Reader {
+    public:
+        Reader(const uint8_t* p, size_t available) : p(p) {
+            if (available < SIZE) {
+                throw std::runtime_error("Truncated protocol record");
+            }
+        }
+        template <size_t I>
+        typename Field<I>::value_type get() const { return Record::template get<I>(p); }
+
+        const uint8_t* data() const { return p; }
+        const uint8_t* end()  const { return p + SIZE; }   // first byte after the record
+
+    private:
+        const uint8_t* p;
+    };
+
+private:
+    template <size_t... I>
+    static void writeFields(uint8_t* out, std::index_sequence<I...>,
+                            const typename Fields::value_type&... values) {
+        (Field<I>::write(out + offset<I>(), values), ...);
+    }
+};
+
+// 603 msgType high bit: the content was deflated before encryption.
+// Only set on text (3) and file (4) messages; peers that don't know the
+// flag see an unknown type and skip the message.
+constexpr uint8_t MSG_COMPRESSED = 0x80;
+constexpr uint8_t MSG_TYPE_MASK  = 0x7F;
+
+// ---- Request header: [16 clientId][1 version][2 code][4 payloadSize] ----
+struct RequestHeader : Record<Id, U8, U16, U32> {
+    enum { CLIENT_ID, VERSION, CODE, PAYLOAD_SIZE };
+};
+
+// ---- Response header: [1 version][2 code][4 payloadSize] ----
+struct ResponseHeader : Record<U8, U16, U32> {
+    enum { VERSION, CODE, PAYLOAD_SIZE };
+};
+
+// ---- 603 body (before the content): [16 toId][1 msgType][4 contentSize] ----
+struct MessageBody : Record<Id, U8, U32> {
+    enum { TO_ID, TYPE, CONTENT_SIZE };
+};
+
+// ---- 605 body: [4 maxBytes][4 maxCount] ----
+struct FetchPageBody : Record<U32, U32> {
+    enum { MAX_BYTES, MAX_COUNT };
+};
+
+// ---- 609 body: [4 timeoutMs][4 maxBytes][4 maxCount] ----
+struct WaitMessagesBody : Record<U32, U32, U32> {
+    enum { TIMEOUT_MS, MAX_BYTES, MAX_COUNT };
+};
+
+// ---- 608 body: [8 sinceVersion] ----
+struct ListDeltaBody : Record<U64> {
+    enum { SINCE_VERSION };
+};
+
+// ---- 2101 entry: [16 clientId][255 name, NUL-padded] ----
+struct ClientEntry : Record<Id, Bytes<255>> {
+    enum { CLIENT_ID, NAME };
+};
+
+// ---- 2104 / 2105 / 2109 entry (before the content): [16 fromId][4 msgId][1 type][4 size] ----
+struct MessageEntry : Record<Id, U32, U8, U32> {
+    enum { FROM_ID, MSG_ID, TYPE, CONTENT_SIZE };
+};
+
+// ---- 2107 record (before the key): [16 clientId][2 keyLen] ----
+struct PublicKeyEntry : Record<Id, U16> {
+    enum { CLIENT_ID, KEY_LEN };
+};
+
+// ---- 2108 head: [8 version][1 full][4 addedCount] ----
+struct ListDeltaHead : Record<U64, U8, U32> {
+    enum { VERSION, FULL, ADDED_COUNT };
+};
+
+static_assert(RequestHeader::SIZE  == 23,  "request header is 23 bytes");
+static_assert(ResponseHeader::SIZE == 7,   "response header is 7 bytes");
+static_assert(MessageBody::SIZE    == 21,  "603 body head is 21 bytes");
+static_assert(FetchPageBody::SIZE  == 8,   "605 body is 8 bytes");
+static_assert(ListDeltaBody::SIZE  == 8,   "608 body is 8 bytes");
+static_assert(WaitMessagesBody::SIZE == 12, "609 body is 12 bytes");
+static_assert(ClientEntry::SIZE    == 271, "2101 entry is 271 bytes");
+static_assert(MessageEntry::SIZE   == 25,  "2104 entry head is 25 bytes");
+static_assert(PublicKeyEntry::SIZE == 18,  "2107 record head is 18 bytes");
+static_assert(ListDeltaHead::SIZE  == 13,  "2108 head is 13 bytes");
+
+static_assert(RequestHeader::offset<RequestHeader::PAYLOAD_SIZE>()   == 19, "");
+static_assert(ResponseHeader::offset<ResponseHeader::PAYLOAD_SIZE>() == 3,  "");
+static_assert(MessageEntry::offset<MessageEntry::CONTENT_SIZE>()     == 21, "");
+
+} // namespace wire
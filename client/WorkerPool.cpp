@@ -0,0 +1,85 @@
+#include "WorkerPool.h"
+#include "Metrics.h"
+
+size_t WorkerPool::defaultSize() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+WorkerPool::WorkerPool(size_t count) {
+    threads.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (threads.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    // Each call gets its own Job, so a worker that wakes late only ever sees
+    // an exhausted index counter, never the next call's
+    auto job   = std::make_shared<Job>();
+    job->fn    = fn;
+    job->count = count;
+#if CLIENT_ENABLE_METRICS
+    // Crypto done on the workers counts for the caller's request
+    if (uint16_t code = Metrics::scopedRequest()) {
+        job->fn = [code, &fn](size_t i) {
+            RequestScope scope(code);
+            fn(i);
+        };
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = job;
+        ++generation;
+    }
+    wake.notify_all();
+
+    runJob(*job);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return job->finished.load() == job->count; });
+    current.reset();
+}
+
+void WorkerPool::runJob(Job& job) {
+    for (size_t i = job.next++; i < job.count; i = job.next++) {
+        job.fn(i);
+        if (++job.finished == job.count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_all();
+        }
+    }
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            job  = current;
+        }
+        if (job) runJob(*job);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-bound batches (e.g. decrypting a
+// mailbox). The calling thread works alongside the pool, so a pool sized
+// cores-1 keeps every core busy.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads = defaultSize());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&)            = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Runs fn(i) for every i in [0, count) and returns once all calls have
+    // finished. fn must not throw; indices are handed out in no fixed order.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    size_t size() const { return threads.size(); }
+    static size_t defaultSize();
+
+private:
+    struct Job {
+        std::function<void(size_t)> fn;
+        size_t                      count = 0;
+        std::atomic<size_t>         next{0};
+        std::atomic<size_t>         finished{0};
+    };
+
+    void workerLoop();
+    void runJob(Job& job);
+
+    std::vector<std::thread> threads;
+    std::mutex               mutex;
+    std::condition_variable  wake;        // new job or shutdown
+    std::condition_variable  done;        // current job finished
+    std::shared_ptr<Job>     current;
+    uint64_t                 generation = 0;
+    bool                     stopping   = false;
+};
@@ -0,0 +1,131 @@
+// aes_throughput – bulk AES-CBC throughput on file-sized payloads.
+//
+// Every size is run with the AES kernel this binary's Crypto++ dispatches to.
+// The build makes two copies: aes_throughput against the configured Crypto++
+// profile, and aes_throughput_portable against a Crypto++ compiled with
+// CRYPTOPP_PROFILE=portable (no ASM / SIMD). Save one run and compare the
+// other against it:
+//   aes_throughput_portable --save portable.txt
+//   aes_throughput --against portable.txt
+#include "CryptoManager.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Throughput {
+    double encryptMBs;
+    double decryptMBs;
+};
+
+static double mbPerSec(size_t bytes, Clock::duration elapsed) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    return secs > 0 ? (bytes / (1024.0 * 1024.0)) / secs : 0.0;
+}
+
+static Throughput measure(const CryptoManager& crypto, size_t size) {
+    auto key = crypto.generateAESKey();
+    std::vector<uint8_t> plain(size, 0x5A);
+
+    // ~256 MB of work per direction, never fewer than 3 runs
+    size_t reps = std::max<size_t>(3, (size_t(256) << 20) / size);
+
+    std::vector<uint8_t> cipher;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < reps; ++i) cipher = crypto.aesCBCEncrypt(plain, key);
+    auto t1 = Clock::now();
+    size_t check = 0;
+    for (size_t i = 0; i < reps; ++i) check += crypto.aesCBCDecrypt(cipher, key).size();
+    auto t2 = Clock::now();
+
+    if (check != reps * size) {
+        std::cerr << "round-trip mismatch at " << size << " bytes\n";
+    }
+    return { mbPerSec(reps * size, t1 - t0), mbPerSec(reps * size, t2 - t1) };
+}
+
+/* ─── saved runs ───────────────────────────────── */
+// One line per size, "<size> <encrypt MB/s> <decrypt MB/s>", after a
+// "kernel <name>" line
+
+static bool saveRun(const std::string& path, const std::map<size_t, Throughput>& run) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "kernel " << CryptoManager::aesImplementation() << "\n";
+    for (const auto& [size, r] : run) {
+        out << size << " " << r.encryptMBs << " " << r.decryptMBs << "\n";
+    }
+    return bool(out);
+}
+
+static bool loadRun(const std::string& path, std::string& kernel, std::map<size_t, Throughput>& run) {
+    std::ifstream in(path);
+    std::string tag;
+    if (!(in >> tag >> kernel) || tag != "kernel") return false;
+    size_t size;
+    Throughput r;
+    while (in >> size >> r.encryptMBs >> r.decryptMBs) run[size] = r;
+    return !run.empty();
+}
+
+/* ─── main ─────────────────────────────────────── */
+
+int main(int argc, char** argv) {
+    std::string savePath, againstPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if      (a == "--save"    && i + 1 < argc) savePath    = argv[++i];
+        else if (a == "--against" && i + 1 < argc) againstPath = argv[++i];
+        else {
+            std::cerr << "usage: " << argv[0] << " [--save <file>] [--against <file>]\n";
+            return 2;
+        }
+    }
+
+    std::string otherKernel;
+    std::map<size_t, Throughput> other;
+    if (!againstPath.empty() && !loadRun(againstPath, otherKernel, other)) {
+        std::cerr << "could not read a saved run from " << againstPath << "\n";
+        return 2;
+    }
+
+    CryptoManager crypto;
+    const std::vector<size_t> sizes = { 64 << 10, 1 << 20, 16 << 20, 64 << 20 };
+
+    std::cout << "cpu features: " << CryptoManager::cpuFeatures() << "\n"
+              << "kernel: " << CryptoManager::aesImplementation() << "\n\n"
+              << std::setw(12) << "size" << std::setw(16) << "encrypt MB/s"
+              << std::setw(16) << "decrypt MB/s" << "\n";
+    std::map<size_t, Throughput> run;
+    for (size_t size : sizes) {
+        auto r = measure(crypto, size);
+        run[size] = r;
+        std::cout << std::setw(12) << size << std::fixed << std::setprecision(1)
+                  << std::setw(16) << r.encryptMBs << std::setw(16) << r.decryptMBs << "\n";
+    }
+
+    if (!savePath.empty() && !saveRun(savePath, run)) {
+        std::cerr << "could not write " << savePath << "\n";
+        return 1;
+    }
+
+    if (!other.empty()) {
+        std::cout << "\nvs. " << otherKernel << " (" << againstPath << ")\n"
+                  << std::setw(12) << "size" << std::setw(16) << "enc speedup"
+                  << std::setw(16) << "dec speedup" << "\n";
+        for (size_t size : sizes) {
+            auto it = other.find(size);
+            if (it == other.end() || it->second.encryptMBs <= 0 || it->second.decryptMBs <= 0) continue;
+            std::cout << std::setw(12) << size << std::fixed << std::setprecision(2)
+                      << std::setw(15) << run[size].encryptMBs / it->second.encryptMBs << "x"
+                      << std::setw(15) << run[size].decryptMBs / it->second.decryptMBs << "x\n";
+        }
+    }
+    return 0;
+}
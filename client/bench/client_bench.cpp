@@ -0,0 +1,515 @@
+// client_bench – micro-benchmark suite for the client's hot paths.
+//
+//   crypto/…   AES-CBC 64 B – 64 MiB, RSA wrap/unwrap, key generation, Deflate
+//   build/…    ProtocolBuilder::build* (frame construction only)
+//   parse/…    ProtocolParser::parse / parseView, 2101 / 2104 / 2107 / 2108 payloads
+//
+// Each case is calibrated to run for about --min-time-ms per batch, then
+// measured over --repeats batches; the median batch gives ns/op. bytes/s is
+// derived from the payload size of one op, allocs/op counts global operator
+// new calls (Crypto++ allocates SecBlock storage with malloc directly, so
+// those are not included).
+//
+// Results go to stdout and, as JSON, to --json (default client_bench.json).
+// With --baseline <old.json> every case is compared against an earlier run
+// and slowdowns beyond --threshold percent are flagged; the exit status is 1
+// if any were found, so a build script can fail on regressions.
+//
+//   client_bench [--filter <substring>] [--json <file>] [--baseline <file>]
+//                [--min-time-ms <n>] [--repeats <n>] [--threshold <percent>]
+#include "CryptoManager.h"
+#include "ProtocolBuilder.h"
+#include "ProtocolParser.h"
+#include "BufferPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* ─── Allocation counting ──────────────────────── */
+
+static std::atomic<uint64_t> g_allocations{ 0 };
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void  operator delete(void* p) noexcept { std::free(p); }
+void  operator delete[](void* p) noexcept { std::free(p); }
+void  operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void  operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+/* ─── Harness ──────────────────────────────────── */
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the optimiser from discarding a result
+template <typename T>
+static inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static const void* volatile sinkPtr;
+    sinkPtr = &value;
+#endif
+}
+
+struct Result {
+    std::string name;
+    uint64_t    iterations  = 0;   // per batch
+    double      nsPerOp     = 0;
+    double      bytesPerSec = 0;   // 0 when the case has no payload size
+    double      allocsPerOp = 0;
+};
+
+struct Options {
+    std::string filter;
+    std::string jsonPath     = "client_bench.json";
+    std::string baselinePath;
+    double      minTimeMs    = 100;
+    int         repeats      = 5;
+    double      threshold    = 10;   // percent
+};
+
+class Suite {
+public:
+    explicit Suite(const Options& opt) : opt(opt) {}
+
+    // `op` runs one operation; `bytes` is the payload it processes (0 = n/a)
+    void add(const std::string& name, size_t bytes, const std::function<void()>& op) {
+        if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos) return;
+
+        op();   // warm-up: caches, lazily built tables, pool buffers
+
+        // Calibrate: grow the batch until it takes at least min-time
+        uint64_t iters = 1;
+        for (;;) {
+            double ns = timeBatch(op, iters);
+            if (ns >= opt.minTimeMs * 1e6 || iters >= (uint64_t(1) << 40)) break;
+            double scale = ns > 0 ? (opt.minTimeMs * 1e6) / ns : 100;
+            iters = std::max<uint64_t>(iters + 1, static_cast<uint64_t>(iters * std::min(scale * 1.2, 100.0)));
+        }
+
+        std::vector<double> perOp;
+        uint64_t allocs0 = g_allocations.load(std::memory_order_relaxed);
+        for (int r = 0; r < opt.repeats; ++r) {
+            perOp.push_back(timeBatch(op, iters) / double(iters));
+        }
+        uint64_t allocs = g_allocations.load(std::memory_order_relaxed) - allocs0;
+        std::sort(perOp.begin(), perOp.end());
+
+        Result res;
+        res.name        = name;
+        res.iterations  = iters;
+        res.nsPerOp     = perOp[perOp.size() / 2];
+        res.bytesPerSec = bytes ? double(bytes) * 1e9 / res.nsPerOp : 0;
+        res.allocsPerOp = double(allocs) / double(iters * uint64_t(opt.repeats));
+        print(res);
+        results.push_back(res);
+    }
+
+    const std::vector<Result>& all() const { return results; }
+
+    static void printHeader() {
+        std::cout << std::left << std::setw(40) << "benchmark" << std::right
+                  << std::setw(14) << "ns/op" << std::setw(14) << "MB/s"
+                  << std::setw(12) << "allocs/op" << std::setw(12) << "iters" << "\n";
+    }
+
+private:
+    static double timeBatch(const std::function<void()>& op, uint64_t iters) {
+        auto t0 = Clock::now();
+        for (uint64_t i = 0; i < iters; ++i) op();
+        auto t1 = Clock::now();
+        return std::chrono::duration<double, std::nano>(t1 - t0).count();
+    }
+
+    static void print(const Result& r) {
+        std::cout << std::left << std::setw(40) << r.name << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(14) << r.nsPerOp;
+        if (r.bytesPerSec > 0) {
+            std::cout << std::setw(14) << r.bytesPerSec / (1024.0 * 1024.0);
+        } else {
+            std::cout << std::setw(14) << "-";
+        }
+        std::cout << std::setprecision(2) << std::setw(12) << r.allocsPerOp
+                  << std::setw(12) << r.iterations << "\n";
+    }
+
+    const Options&      opt;
+    std::vector<Result> results;
+};
+
+/* ─── JSON ─────────────────────────────────────── */
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// One result per line, so a baseline can be read back without a JSON library
+static bool writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    char when[32] = "";
+    std::time_t now = std::time(nullptr);
+    std::strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    out << "{\n"
+        << "  \"timestamp\": \"" << when << "\",\n"
+        << "  \"aes_kernel\": \"" << jsonEscape(CryptoManager::aesImplementation()) << "\",\n"
+        << "  \"cpu_features\": \"" << jsonEscape(CryptoManager::cpuFeatures()) << "\",\n"
+#if defined(__clang__)
+        << "  \"compiler\": \"clang " << __clang_major__ << "." << __clang_minor__ << "\",\n"
+#elif defined(__GNUC__)
+        << "  \"compiler\": \"gcc " << __GNUC__ << "." << __GNUC_MINOR__ << "\",\n"
+#elif defined(_MSC_VER)
+        << "  \"compiler\": \"msvc " << _MSC_VER << "\",\n"
+#endif
+        << "  \"results\": [\n";
+    out << std::setprecision(17);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    {\"name\": \"" << jsonEscape(r.name) << "\""
+            << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"bytes_per_sec\": " << r.bytesPerSec
+            << ", \"allocs_per_op\": " << r.allocsPerOp
+            << ", \"iterations\": " << r.iterations << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.good();
+}
+
+// name → ns/op from a file written by writeJson
+static std::map<std::string, double> readBaseline(const std::string& path) {
+    std::map<std::string, double> base;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto n = line.find("\"name\": \"");
+        auto t = line.find("\"ns_per_op\": ");
+        if (n == std::string::npos || t == std::string::npos) continue;
+        n += 9;
+        auto end = line.find('"', n);
+        if (end == std::string::npos) continue;
+        base[line.substr(n, end - n)] = std::strtod(line.c_str() + t + 13, nullptr);
+    }
+    return base;
+}
+
+static int compareWithBaseline(const Options& opt, const std::vector<Result>& results) {
+    auto base = readBaseline(opt.baselinePath);
+    if (base.empty()) {
+        std::cerr << "No results in baseline " << opt.baselinePath << "\n";
+        return 1;
+    }
+    std::cout << "\nvs. " << opt.baselinePath << "\n"
+              << std::left << std::setw(40) << "benchmark" << std::right
+              << std::setw(14) << "base ns/op" << std::setw(14) << "now ns/op"
+              << std::setw(10) << "change" << "\n";
+    int regressions = 0;
+    for (const auto& r : results) {
+        auto it = base.find(r.name);
+        if (it == base.end() || it->second <= 0) continue;
+        double change = (r.nsPerOp / it->second - 1.0) * 100.0;
+        bool slower   = change > opt.threshold;
+        regressions  += slower;
+        std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(14) << it->second
+                  << std::setw(14) << r.nsPerOp << std::setw(9) << std::showpos << change
+                  << "%" << std::noshowpos << (slower ? "  REGRESSION" : "") << "\n";
+    }
+    std::cout << regressions << " regression(s) beyond " << opt.threshold << "%\n";
+    return regressions ? 1 : 0;
+}
+
+/* ─── Fixtures ─────────────────────────────────── */
+
+static std::vector<uint8_t> randomBytes(std::mt19937& rng, size_t n) {
+    std::vector<uint8_t> v(n);
+    for (auto& b : v) b = static_cast<uint8_t>(rng());
+    return v;
+}
+
+static ClientId randomId(std::mt19937& rng) {
+    ClientId id;
+    for (auto& b : id.bytes) b = static_cast<uint8_t>(rng());
+    return id;
+}
+
+// Log-like text: compressible, but not trivially so
+static std::vector<uint8_t> textBytes(std::mt19937& rng, size_t n) {
+    static const char* words[] = { "client", "server", "message", "key", "sent", "fetch",
+                                   "ok", "error", "group", "file", "2104", "queue" };
+    std::string s;
+    while (s.size() < n) {
+        s += words[rng() % 12];
+        s += (rng() % 8 == 0) ? '\n' : ' ';
+    }
+    return { s.begin(), s.begin() + static_cast<std::ptrdiff_t>(n) };
+}
+
+static std::vector<uint8_t> response(uint16_t code, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> raw(wire::ResponseHeader::SIZE + payload.size());
+    wire::ResponseHeader::write(raw.data(), uint8_t{2}, code, static_cast<uint32_t>(payload.size()));
+    std::copy(payload.begin(), payload.end(), raw.begin() + wire::ResponseHeader::SIZE);
+    return raw;
+}
+
+static std::string sizeLabel(size_t n) {
+    if (n >= (1u << 20)) return std::to_string(n >> 20) + "M";
+    if (n >= (1u << 10)) return std::to_string(n >> 10) + "K";
+    return std::to_string(n);
+}
+
+/* ─── Cases ────────────────────────────────────── */
+
+static void cryptoCases(Suite& suite) {
+    CryptoManager crypto;
+    std::mt19937  rng(1);
+    auto pool = [](std::vector<uint8_t>& v) { BufferPool::shared().release(std::move(v)); };
+
+    ClientId peer    = randomId(rng);
+    auto     key     = crypto.generateAESKey();
+    auto     session = crypto.setSessionKey(peer, key);
+
+    for (size_t size : { size_t(64), size_t(1) << 10, size_t(64) << 10, size_t(1) << 20, size_t(64) << 20 }) {
+        auto plain  = randomBytes(rng, size);
+        auto cipher = crypto.aesCBCEncrypt(plain.data(), plain.size(), *session);
+        suite.add("crypto/aes_cbc_encrypt/" + sizeLabel(size), size, [&] {
+            auto out = crypto.aesCBCEncrypt(plain.data(), plain.size(), *session);
+            keep(out);
+            pool(out);
+        });
+        suite.add("crypto/aes_cbc_decrypt/" + sizeLabel(size), size, [&] {
+            auto out = crypto.aesCBCDecrypt(cipher.data(), cipher.size(), *session);
+            keep(out);
+            pool(out);
+        });
+    }
+
+    suite.add("crypto/aes_keygen", 0, [&] {
+        auto k = crypto.generateAESKey();
+        keep(k);
+    });
+    suite.add("crypto/aes_session_setup", 0, [&] {
+        auto s = crypto.setSessionKey(peer, key);
+        keep(s);
+    });
+
+    crypto.generateRSAKeyPair();
+    ClientId self = randomId(rng);
+    crypto.setPeerPublicKey(self, crypto.getPublicKeyDER());
+    auto wrapped = crypto.encryptRSAFor(self, key);
+    suite.add("crypto/rsa_encrypt", key.size(), [&] {
+        auto c = crypto.encryptRSAFor(self, key);
+        keep(c);
+    });
+    suite.add("crypto/rsa_decrypt", key.size(), [&] {
+        auto p = crypto.decryptRSA(wrapped);
+        keep(p);
+    });
+    {
+        CryptoManager keygen;   // keeps the main instance's key pair intact
+        suite.add("crypto/rsa_keygen_1024", 0, [&] { keygen.generateRSAKeyPair(); });
+    }
+
+    auto text    = textBytes(rng, 64 << 10);
+    auto packed  = crypto.deflate(text.data(), text.size());
+    suite.add("crypto/deflate/64K", text.size(), [&] {
+        auto out = crypto.deflate(text.data(), text.size());
+        keep(out);
+        pool(out);
+    });
+    suite.add("crypto/inflate/64K", text.size(), [&] {
+        auto out = crypto.inflate(packed.data(), packed.size(), text.size());
+        keep(out);
+        pool(out);
+    });
+}
+
+static void buildCases(Suite& suite) {
+    std::mt19937 rng(2);
+    ClientId self = randomId(rng), peer = randomId(rng), group = randomId(rng);
+    auto cipher   = randomBytes(rng, 1024);
+    auto der      = randomBytes(rng, 160);
+    std::string name = "benchmark-user";
+    std::vector<ClientId> members;
+    for (int i = 0; i < 32; ++i) members.push_back(randomId(rng));
+    std::vector<ClientId> ids;
+    for (int i = 0; i < 64; ++i) ids.push_back(randomId(rng));
+
+    auto add = [&suite](const std::string& label, const std::function<Frame()>& build) {
+        size_t bytes = build().size();
+        suite.add("build/" + label, bytes, [build] {
+            Frame f = build();
+            keep(f);
+        });
+    };
+    add("header",            [&] { return ProtocolBuilder::buildHeader(self, 2, 601, 0); });
+    add("register",          [&] { return ProtocolBuilder::buildRegisterRequest(name, der); });
+    add("fetch_page",        [&] { return ProtocolBuilder::buildFetchPageRequest(self, 4 << 20, 256); });
+    add("send_text/1K",      [&] { return ProtocolBuilder::buildSendTextRequest(self, peer, cipher); });
+    add("group_key/32",      [&] { return ProtocolBuilder::buildSendGroupKeyRequest(self, peer, group, name, members, der); });
+    add("group_text/32",     [&] { return ProtocolBuilder::buildSendGroupTextRequest(self, group, members, cipher); });
+    add("get_public_keys/64", [&] { return ProtocolBuilder::buildGetPublicKeysRequest(self, ids); });
+
+    // Flattening is what a caller pays when it needs one contiguous buffer
+    Frame text = ProtocolBuilder::buildSendTextRequest(self, peer, cipher);
+    suite.add("build/send_text/1K+flatten", text.size(), [&] {
+        auto flat = ProtocolBuilder::buildSendTextRequest(self, peer, cipher).flatten();
+        keep(flat);
+    });
+}
+
+static void parseCases(Suite& suite) {
+    std::mt19937 rng(3);
+    auto pool = [](std::vector<uint8_t>& v) { BufferPool::shared().release(std::move(v)); };
+
+    auto small = response(2103, randomBytes(rng, 20));
+    auto big   = response(2104, randomBytes(rng, 64 << 10));
+    suite.add("parse/parse/20", small.size(), [&] {
+        auto m = ProtocolParser::parse(small);
+        keep(m);
+        pool(m.payload);
+    });
+    suite.add("parse/parse/64K", big.size(), [&] {
+        auto m = ProtocolParser::parse(big);
+        keep(m);
+        pool(m.payload);
+    });
+    suite.add("parse/parse_view/64K", big.size(), [&] {
+        auto v = ProtocolParser::parseView(big);
+        keep(v);
+    });
+
+    // 2101 – 1000 client records
+    std::vector<uint8_t> list(1000 * wire::ClientEntry::SIZE, 0);
+    for (size_t i = 0; i < 1000; ++i) {
+        uint8_t* rec = list.data() + i * wire::ClientEntry::SIZE;
+        auto id = randomId(rng);
+        std::memcpy(rec, id.data(), ClientId::SIZE);
+        std::string n = "user" + std::to_string(i);
+        std::memcpy(rec + ClientId::SIZE, n.data(), n.size());
+    }
+    suite.add("parse/2101_clients/1000", list.size(), [&] {
+        auto recs = ProtocolParser::parseClientList(ByteView(list.data(), list.size()));
+        keep(recs);
+    });
+
+    // 2108 – full list of the same 1000 records, plus 100 removals
+    std::vector<uint8_t> delta(wire::ListDeltaHead::SIZE);
+    wire::ListDeltaHead::write(delta.data(), uint64_t{42}, uint8_t{1}, uint32_t{1000});
+    delta.insert(delta.end(), list.begin(), list.end());
+    delta.resize(delta.size() + 4);
+    wire::U32::write(delta.data() + delta.size() - 4, 100);
+    auto removed = randomBytes(rng, 100 * ClientId::SIZE);
+    delta.insert(delta.end(), removed.begin(), removed.end());
+    suite.add("parse/2108_delta/1000+100", delta.size(), [&] {
+        auto d = ProtocolParser::parseClientListDelta(ByteView(delta.data(), delta.size()));
+        keep(d);
+    });
+
+    // 2107 – 64 public keys of 160 bytes
+    std::vector<uint8_t> keys(2);
+    wire::U16::write(keys.data(), 64);
+    for (int i = 0; i < 64; ++i) {
+        uint8_t head[wire::PublicKeyEntry::SIZE];
+        wire::PublicKeyEntry::write(head, randomId(rng), uint16_t{160});
+        keys.insert(keys.end(), head, head + sizeof(head));
+        auto der = randomBytes(rng, 160);
+        keys.insert(keys.end(), der.begin(), der.end());
+    }
+    suite.add("parse/2107_keys/64", keys.size(), [&] {
+        auto recs = ProtocolParser::parsePublicKeys(ByteView(keys.data(), keys.size()));
+        keep(recs);
+    });
+
+    // 2104 – 256 entries of 100-byte content, walked as Client::readMessageEntries does
+    std::vector<uint8_t> entries;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint8_t head[wire::MessageEntry::SIZE];
+        wire::MessageEntry::write(head, randomId(rng), i, uint8_t{3}, uint32_t{100});
+        entries.insert(entries.end(), head, head + sizeof(head));
+        auto body = randomBytes(rng, 100);
+        entries.insert(entries.end(), body.begin(), body.end());
+    }
+    suite.add("parse/2104_entries/256", entries.size(), [&] {
+        size_t   off = 0;
+        uint64_t sum = 0;
+        while (off < entries.size()) {
+            if (entries.size() - off < ProtocolParser::MESSAGE_ENTRY_HEADER_SIZE) break;
+            auto e = ProtocolParser::parseMessageEntryHeader(entries.data() + off);
+            off += ProtocolParser::MESSAGE_ENTRY_HEADER_SIZE;
+            if (e.size > entries.size() - off) break;
+            sum += e.msgId + e.type;
+            off += e.size;
+        }
+        keep(sum);
+    });
+}
+
+/* ─── main ─────────────────────────────────────── */
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if      (a == "--filter"      && (v = next())) opt.filter       = v;
+        else if (a == "--json"        && (v = next())) opt.jsonPath     = v;
+        else if (a == "--baseline"    && (v = next())) opt.baselinePath = v;
+        else if (a == "--min-time-ms" && (v = next())) opt.minTimeMs    = std::max(1.0, std::atof(v));
+        else if (a == "--repeats"     && (v = next())) opt.repeats      = std::max(1, std::atoi(v));
+        else if (a == "--threshold"   && (v = next())) opt.threshold    = std::atof(v);
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter <substring>] [--json <file>] [--baseline <file>]"
+                         " [--min-time-ms <n>] [--repeats <n>] [--threshold <percent>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 2;
+
+    std::cout << "aes kernel: " << CryptoManager::aesImplementation()
+              << ", cpu features: " << CryptoManager::cpuFeatures() << "\n\n";
+    Suite suite(opt);
+    Suite::printHeader();
+    cryptoCases(suite);
+    buildCases(suite);
+    parseCases(suite);
+
+    if (!opt.jsonPath.empty()) {
+        if (writeJson(opt.jsonPath, suite.all())) {
+            std::cout << "\nresults written to " << opt.jsonPath << "\n";
+        } else {
+            std::cerr << "Failed to write " << opt.jsonPath << "\n";
+        }
+    }
+    return opt.baselinePath.empty() ? 0 : compareWithBaseline(opt, suite.all());
+}
@@ -0,0 +1,99 @@
+// clientid_lookup – per-peer cache lookup cost with 100k peers.
+//
+// Compares the old scheme (IDs as std::vector, caches keyed by the
+// ostringstream hex string) with ClientId keys in std::unordered_map and in
+// FlatHashMap. Each lookup starts from the ID bytes as they arrive from the
+// wire, so the hex formatting of the old scheme is part of its cost.
+#include "ClientId.h"
+#include "FlatHashMap.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static std::string toHex(const std::vector<uint8_t>& b) {
+    std::ostringstream oss;
+    for (auto x : b) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << int(x);
+    }
+    return oss.str();
+}
+
+template <typename Fn>
+static double nsPerOp(size_t ops, Fn&& fn) {
+    auto t0 = Clock::now();
+    fn();
+    auto t1 = Clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / ops;
+}
+
+int main() {
+    const size_t PEERS   = 100000;
+    const size_t LOOKUPS = 2000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<uint8_t>> ids(PEERS, std::vector<uint8_t>(16));
+    for (auto& id : ids) {
+        for (auto& b : id) b = static_cast<uint8_t>(rng());
+    }
+    // lookup order: random peers, ~10% of them unknown
+    std::vector<std::vector<uint8_t>> probes(LOOKUPS);
+    for (auto& p : probes) {
+        if (rng() % 10 == 0) {
+            p.resize(16);
+            for (auto& b : p) b = static_cast<uint8_t>(rng());
+        } else {
+            p = ids[rng() % PEERS];
+        }
+    }
+    const std::vector<uint8_t> key(16, 0x42);   // an AES key per peer
+
+    std::unordered_map<std::string, std::vector<uint8_t>> byHex;
+    std::unordered_map<ClientId, std::vector<uint8_t>>    byIdStd;
+    FlatHashMap<ClientId, std::vector<uint8_t>>           byIdFlat;
+
+    double insHex = nsPerOp(PEERS, [&] {
+        for (const auto& id : ids) byHex[toHex(id)] = key;
+    });
+    double insStd = nsPerOp(PEERS, [&] {
+        for (const auto& id : ids) byIdStd[ClientId(id.data())] = key;
+    });
+    double insFlat = nsPerOp(PEERS, [&] {
+        for (const auto& id : ids) byIdFlat[ClientId(id.data())] = key;
+    });
+
+    size_t hits[3] = { 0, 0, 0 };
+    double findHex = nsPerOp(LOOKUPS, [&] {
+        for (const auto& p : probes) hits[0] += byHex.count(toHex(p));
+    });
+    double findStd = nsPerOp(LOOKUPS, [&] {
+        for (const auto& p : probes) hits[1] += byIdStd.count(ClientId(p.data()));
+    });
+    double findFlat = nsPerOp(LOOKUPS, [&] {
+        for (const auto& p : probes) hits[2] += byIdFlat.contains(ClientId(p.data()));
+    });
+
+    if (hits[0] != hits[1] || hits[1] != hits[2]) {
+        std::cerr << "lookup results differ\n";
+        return 1;
+    }
+
+    std::cout << PEERS << " peers, " << LOOKUPS << " lookups ("
+              << hits[0] << " hits)\n"
+              << std::setw(34) << "map" << std::setw(14) << "insert ns"
+              << std::setw(14) << "lookup ns" << "\n"
+              << std::fixed << std::setprecision(1)
+              << std::setw(34) << "unordered_map<hex string>"
+              << std::setw(14) << insHex  << std::setw(14) << findHex  << "\n"
+              << std::setw(34) << "unordered_map<ClientId>"
+              << std::setw(14) << insStd  << std::setw(14) << findStd  << "\n"
+              << std::setw(34) << "FlatHashMap<ClientId>"
+              << std::setw(14) << insFlat << std::setw(14) << findFlat << "\n";
+    return 0;
+}
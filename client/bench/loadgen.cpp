@@ -0,0 +1,383 @@
+// loadgen – many simulated users against a running server.
+//
+// Each identity is a ClientSession on its own thread and connection. After
+// a setup phase (register, list, key exchange with --peers others) every
+// thread runs a closed loop for --duration seconds, picking operations by
+// the --mix weights. Per request code the round trips are collected and
+// reported as throughput and p50 / p99 / p999 latency. `wait` is a 609 long
+// poll held for at most --wait-ms; it is in no default mix.
+//
+//   loadgen --clients 200 --duration 30 --mix text=60,file=5,fetch=25,list=5,key=5
+//
+// The server address comes from --host / --port, else server.info, else
+// 127.0.0.1:1234. Identities are registered under a per-run prefix and are
+// not saved anywhere.
+#include "ClientSession.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+/* ─── Options ──────────────────────────────────── */
+
+enum Op { OP_TEXT, OP_FILE, OP_FETCH, OP_LIST, OP_KEY, OP_WAIT, OP_COUNT };
+static const char* const OP_NAMES[OP_COUNT] = { "text", "file", "fetch", "list", "key", "wait" };
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int         port = 1234;
+    size_t      clients     = 50;
+    double      durationSec = 10;
+    unsigned    weights[OP_COUNT] = { 60, 5, 25, 5, 5, 0 };
+    size_t      textSize   = 256;
+    size_t      fileSize   = 64 * 1024;
+    unsigned    thinkMs    = 0;
+    size_t      peers      = 4;
+    uint32_t    fetchBytes = 1024 * 1024;
+    uint32_t    fetchCount = 256;
+    uint32_t    waitMs     = 100;
+    std::string jsonPath;
+};
+
+static void usage() {
+    std::cerr << "usage: loadgen [--host H] [--port P] [--clients N] [--duration SEC]\n"
+                 "               [--mix text=W,file=W,fetch=W,list=W,key=W,wait=W]\n"
+                 "               [--text-size BYTES] [--file-size BYTES] [--think-ms MS]\n"
+                 "               [--peers K] [--fetch-bytes BYTES] [--fetch-count N] [--wait-ms MS]\n"
+                 "               [--json FILE]\n";
+}
+
+static void readServerInfo(Options& opt) {
+    std::ifstream f("server.info");
+    std::string line;
+    if (!f || !std::getline(f, line)) return;
+    auto p = line.find(':');
+    if (p == std::string::npos) return;
+    opt.host = line.substr(0, p);
+    opt.port = std::stoi(line.substr(p + 1));
+}
+
+static void parseMix(const std::string& spec, Options& opt) {
+    std::fill(std::begin(opt.weights), std::end(opt.weights), 0u);
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        auto eq = item.find('=');
+        if (eq == std::string::npos) throw std::runtime_error("Bad --mix entry: " + item);
+        std::string name = item.substr(0, eq);
+        auto it = std::find_if(std::begin(OP_NAMES), std::end(OP_NAMES),
+                               [&](const char* n) { return name == n; });
+        if (it == std::end(OP_NAMES)) throw std::runtime_error("Unknown --mix operation: " + name);
+        opt.weights[it - std::begin(OP_NAMES)] = static_cast<unsigned>(std::stoul(item.substr(eq + 1)));
+    }
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+    readServerInfo(opt);
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) { usage(); return false; }
+        std::string v = argv[++i];
+        if      (a == "--host")        opt.host        = v;
+        else if (a == "--port")        opt.port        = std::stoi(v);
+        else if (a == "--clients")     opt.clients     = std::stoul(v);
+        else if (a == "--duration")    opt.durationSec = std::stod(v);
+        else if (a == "--mix")         parseMix(v, opt);
+        else if (a == "--text-size")   opt.textSize    = std::stoul(v);
+        else if (a == "--file-size")   opt.fileSize    = std::stoul(v);
+        else if (a == "--think-ms")    opt.thinkMs     = static_cast<unsigned>(std::stoul(v));
+        else if (a == "--peers")       opt.peers       = std::stoul(v);
+        else if (a == "--fetch-bytes") opt.fetchBytes  = static_cast<uint32_t>(std::stoul(v));
+        else if (a == "--fetch-count") opt.fetchCount  = static_cast<uint32_t>(std::stoul(v));
+        else if (a == "--wait-ms")     opt.waitMs      = static_cast<uint32_t>(std::stoul(v));
+        else if (a == "--json")        opt.jsonPath    = v;
+        else { usage(); return false; }
+    }
+    if (opt.clients < 2) {
+        std::cerr << "--clients must be at least 2\n";
+        return false;
+    }
+    opt.peers = std::min(opt.peers, opt.clients - 1);
+    return true;
+}
+
+/* ─── Per-thread results ───────────────────────── */
+
+struct CodeSamples {
+    std::vector<uint64_t> latencyNs;
+    uint64_t              errors = 0;   // any response but the expected one
+};
+
+struct WorkerResult {
+    std::map<uint16_t, CodeSamples> byCode;
+    uint64_t ops[OP_COUNT] = {};
+    uint64_t failures   = 0;   // operations that threw
+    uint64_t received   = 0;   // messages fetched
+    uint64_t undecrypted = 0;  // texts / files without a usable key
+    std::string firstError;
+};
+
+// Releases all threads once `count` have arrived
+class Barrier {
+public:
+    explicit Barrier(size_t count) : remaining(count) {}
+    void arriveAndWait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (--remaining == 0) {
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [this] { return remaining == 0; });
+    }
+
+private:
+    std::mutex              mutex;
+    std::condition_variable cv;
+    size_t                  remaining;
+};
+
+static bool isSuccess(uint16_t request, uint16_t response) {
+    switch (request) {
+        case 600: return response == 2100;
+        case 601: return response == 2101;
+        case 602: return response == 2102;
+        case 603: return response == 2103;
+        case 604: return response == 2104;
+        case 605: return response == 2105;
+        case 609: return response == 2109;
+        default:  return false;
+    }
+}
+
+/* ─── Worker ───────────────────────────────────── */
+
+struct Shared {
+    const Options&        opt;
+    std::string           runTag;
+    std::vector<ClientId> ids;          // by worker index, filled during setup
+    Barrier               registered;
+    Barrier               keyed;        // also waited on by main: the load phase starts
+
+    Shared(const Options& o, std::string tag)
+        : opt(o), runTag(std::move(tag)), ids(o.clients), registered(o.clients), keyed(o.clients + 1) {}
+};
+
+static void runWorker(size_t index, Shared& shared, WorkerResult& result) {
+    const Options& opt = shared.opt;
+    std::mt19937_64 rng(index * 7919 + 1);
+
+    // Only the load phase is recorded
+    bool measuring = false;
+    ClientSession session(opt.host, opt.port);
+    session.setObserver([&](uint16_t req, uint16_t resp, std::chrono::nanoseconds elapsed) {
+        if (!measuring) return;
+        auto& s = result.byCode[req];
+        s.latencyNs.push_back(static_cast<uint64_t>(elapsed.count()));
+        if (!isSuccess(req, resp)) ++s.errors;
+    });
+
+    std::vector<ClientId> peers;
+    bool ok = true;
+    try {
+        shared.ids[index] = session.registerUser(shared.runTag + "_" + std::to_string(index));
+    } catch (const std::exception& e) {
+        result.firstError = e.what();
+        ok = false;
+    }
+    shared.registered.arriveAndWait();
+
+    // Peers are the next K identities, so every user has K senders too
+    if (ok) {
+        try {
+            session.listClients();
+            for (size_t k = 1; k <= opt.peers; ++k) {
+                const ClientId& peer = shared.ids[(index + k) % opt.clients];
+                if (peer == ClientId()) continue;   // that worker failed to register
+                session.sendSymKey(peer);
+                peers.push_back(peer);
+            }
+        } catch (const std::exception& e) {
+            if (result.firstError.empty()) result.firstError = e.what();
+            ok = false;
+        }
+    }
+    shared.keyed.arriveAndWait();
+    if (!ok || peers.empty()) return;
+
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(opt.durationSec));
+    measuring = true;
+
+    // The sessions' own keys for their peers are replaced whenever a fetch
+    // installs a key from that peer; texts then go out under the newer key
+    std::string               text(opt.textSize, 't');
+    std::vector<uint8_t>      file(opt.fileSize);
+    for (auto& b : file) b = static_cast<uint8_t>(rng());
+    unsigned totalWeight = 0;
+    for (unsigned w : opt.weights) totalWeight += w;
+
+    while (Clock::now() < deadline) {
+        unsigned pick = static_cast<unsigned>(rng() % totalWeight);
+        int op = 0;
+        while (pick >= opt.weights[op]) pick -= opt.weights[op++];
+        const ClientId& peer = peers[rng() % peers.size()];
+
+        try {
+            switch (op) {
+                case OP_TEXT:  session.sendText(peer, text); break;
+                case OP_FILE:  session.sendFile(peer, file); break;
+                case OP_LIST:  session.listClients();        break;
+                case OP_KEY:   session.sendSymKey(peer);     break;
+                case OP_FETCH:
+                case OP_WAIT: {
+                    auto msgs = op == OP_WAIT
+                            ? session.wait(opt.waitMs, opt.fetchBytes, opt.fetchCount)
+                            : session.fetch(opt.fetchBytes, opt.fetchCount);
+                    result.received += msgs.size();
+                    for (const auto& m : msgs) {
+                        uint8_t type = m.type & wire::MSG_TYPE_MASK;
+                        if ((type == 3 || type == 4) && !m.decrypted) ++result.undecrypted;
+                    }
+                    break;
+                }
+            }
+            ++result.ops[op];
+        } catch (const std::exception& e) {
+            ++result.failures;
+            if (result.firstError.empty()) result.firstError = e.what();
+        }
+        if (opt.thinkMs) std::this_thread::sleep_for(std::chrono::milliseconds(opt.thinkMs));
+    }
+}
+
+/* ─── Report ───────────────────────────────────── */
+
+struct CodeReport {
+    uint16_t code;
+    uint64_t count, errors;
+    double   perSec, p50Ms, p99Ms, p999Ms, maxMs;
+};
+
+static double percentileMs(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1] / 1e6;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    try {
+        if (!parseArgs(argc, argv, opt)) return 2;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        usage();
+        return 2;
+    }
+    unsigned totalWeight = 0;
+    for (unsigned w : opt.weights) totalWeight += w;
+    if (totalWeight == 0) {
+        std::cerr << "--mix has no operations\n";
+        return 2;
+    }
+
+    std::string tag = "lg" + std::to_string(
+            std::chrono::system_clock::now().time_since_epoch().count() % 1000000000);
+    Shared shared(opt, tag);
+    std::vector<WorkerResult> results(opt.clients);
+
+    std::cout << "loadgen: " << opt.clients << " clients against " << opt.host << ":"
+              << opt.port << ", " << opt.durationSec << " s\n";
+
+    auto setupStart = Clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(opt.clients);
+    for (size_t i = 0; i < opt.clients; ++i) {
+        threads.emplace_back(runWorker, i, std::ref(shared), std::ref(results[i]));
+    }
+
+    // Setup is done once every worker is keyed; each then runs for --duration
+    shared.keyed.arriveAndWait();
+    auto loadStart = Clock::now();
+    double setupSec = std::chrono::duration<double>(loadStart - setupStart).count();
+
+    for (auto& t : threads) t.join();
+    double loadSec = std::chrono::duration<double>(Clock::now() - loadStart).count();
+
+    // Merge
+    std::map<uint16_t, CodeSamples> merged;
+    uint64_t ops[OP_COUNT] = {}, failures = 0, received = 0, undecrypted = 0, idle = 0;
+    std::string firstError;
+    for (auto& r : results) {
+        for (auto& [code, s] : r.byCode) {
+            auto& m = merged[code];
+            m.latencyNs.insert(m.latencyNs.end(), s.latencyNs.begin(), s.latencyNs.end());
+            m.errors += s.errors;
+        }
+        uint64_t mine = 0;
+        for (int op = 0; op < OP_COUNT; ++op) { ops[op] += r.ops[op]; mine += r.ops[op]; }
+        if (mine == 0) ++idle;
+        failures    += r.failures;
+        received    += r.received;
+        undecrypted += r.undecrypted;
+        if (firstError.empty()) firstError = r.firstError;
+    }
+
+    std::vector<CodeReport> report;
+    uint64_t totalRequests = 0;
+    for (auto& [code, s] : merged) {
+        std::sort(s.latencyNs.begin(), s.latencyNs.end());
+        report.push_back({ code, s.latencyNs.size(), s.errors, s.latencyNs.size() / loadSec,
+                           percentileMs(s.latencyNs, 0.50), percentileMs(s.latencyNs, 0.99),
+                           percentileMs(s.latencyNs, 0.999),
+                           s.latencyNs.empty() ? 0 : s.latencyNs.back() / 1e6 });
+        totalRequests += s.latencyNs.size();
+    }
+
+    std::cout << "setup " << std::fixed << std::setprecision(2) << setupSec << " s, load "
+              << loadSec << " s, " << totalRequests << " requests ("
+              << totalRequests / loadSec << " req/s)\n\n"
+              << std::setw(6) << "code" << std::setw(10) << "count" << std::setw(8) << "errors"
+              << std::setw(11) << "req/s" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+              << std::setw(10) << "p999 ms" << std::setw(10) << "max ms" << "\n";
+    for (const auto& r : report) {
+        std::cout << std::setw(6) << r.code << std::setw(10) << r.count << std::setw(8) << r.errors
+                  << std::setw(11) << std::setprecision(1) << r.perSec
+                  << std::setprecision(3) << std::setw(10) << r.p50Ms << std::setw(10) << r.p99Ms
+                  << std::setw(10) << r.p999Ms << std::setw(10) << r.maxMs << "\n";
+    }
+    std::cout << "\noperations:";
+    for (int op = 0; op < OP_COUNT; ++op) std::cout << " " << OP_NAMES[op] << "=" << ops[op];
+    std::cout << "\nmessages fetched " << received << " (" << undecrypted << " without a key), "
+              << failures << " failed operations";
+    if (idle) std::cout << ", " << idle << " clients idle after setup";
+    std::cout << "\n";
+    if (!firstError.empty()) std::cout << "first error: " << firstError << "\n";
+
+    if (!opt.jsonPath.empty()) {
+        std::ofstream out(opt.jsonPath);
+        out << std::fixed << std::setprecision(3)
+            << "{\"clients\": " << opt.clients << ", \"duration_s\": " << loadSec
+            << ", \"setup_s\": " << setupSec << ", \"requests_per_s\": " << totalRequests / loadSec
+            << ", \"failed_operations\": " << failures << ", \"codes\": [\n";
+        for (size_t i = 0; i < report.size(); ++i) {
+            const auto& r = report[i];
+            out << "  {\"code\": " << r.code << ", \"count\": " << r.count << ", \"errors\": " << r.errors
+                << ", \"per_s\": " << r.perSec << ", \"p50_ms\": " << r.p50Ms << ", \"p99_ms\": "
+                << r.p99Ms << ", \"p999_ms\": " << r.p999Ms << ", \"max_ms\": " << r.maxMs << "}"
+                << (i + 1 < report.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+    }
+    return failures == 0 && idle == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// schema_bench – wire::Record writers/readers vs. the hand-written code.
+//
+// Encodes a request header + 603 body (44 bytes) and decodes 2104 entry
+// heads and response headers, once with the byte-by-byte shifts the
+// builder and parser used before ProtocolSchema.h, once through the
+// schema. Both must produce the same bytes / values.
+#include "ProtocolSchema.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+static double nsPerOp(size_t ops, Fn&& fn) {
+    auto t0 = Clock::now();
+    fn();
+    auto t1 = Clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / ops;
+}
+
+// Keeps the optimiser from discarding a result
+static void sink(uint64_t v) {
+    static volatile uint64_t s;
+    s = s + v;
+}
+
+/* ─── Hand-written reference ───────────────────── */
+
+static void handAppend16(uint8_t*& p, uint16_t v) {
+    *p++ = static_cast<uint8_t>(v & 0xFF);
+    *p++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+}
+
+static void handAppend32(uint8_t*& p, uint32_t v) {
+    *p++ = static_cast<uint8_t>(v & 0xFF);
+    *p++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+    *p++ = static_cast<uint8_t>((v >> 16) & 0xFF);
+    *p++ = static_cast<uint8_t>((v >> 24) & 0xFF);
+}
+
+static uint32_t handRead32(const uint8_t* p) {
+    return  static_cast<uint32_t>(p[0])        |
+           (static_cast<uint32_t>(p[1]) << 8)  |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void handEncode(uint8_t* out, const ClientId& from, const ClientId& to, uint32_t size) {
+    uint8_t* p = out;
+    std::memcpy(p, from.data(), 16); p += 16;
+    *p++ = 1;
+    handAppend16(p, 603);
+    handAppend32(p, 16 + 1 + 4 + size);
+    std::memcpy(p, to.data(), 16); p += 16;
+    *p++ = 3;
+    handAppend32(p, size);
+}
+
+static uint64_t handDecodeEntry(const uint8_t* raw) {
+    ClientId from(raw);
+    uint32_t msgId = handRead32(raw + 16);
+    uint8_t  type  = raw[20];
+    uint32_t size  = handRead32(raw + 21);
+    return from.bytes[0] + msgId + type + size;
+}
+
+static uint64_t handDecodeHeader(const uint8_t* raw) {
+    uint8_t  version = raw[0];
+    uint16_t code    = static_cast<uint16_t>(raw[1]) | (static_cast<uint16_t>(raw[2]) << 8);
+    uint32_t size    = handRead32(raw + 3);
+    return version + code + size;
+}
+
+/* ─── Schema ───────────────────────────────────── */
+
+static void schemaEncode(uint8_t* out, const ClientId& from, const ClientId& to, uint32_t size) {
+    wire::RequestHeader::write(out, from, uint8_t{1}, uint16_t{603},
+                               static_cast<uint32_t>(wire::MessageBody::SIZE + size));
+    wire::MessageBody::write(out + wire::RequestHeader::SIZE, to, uint8_t{3}, size);
+}
+
+static uint64_t schemaDecodeEntry(const uint8_t* raw) {
+    using E = wire::MessageEntry;
+    return E::get<E::FROM_ID>(raw).bytes[0] + E::get<E::MSG_ID>(raw) +
+           E::get<E::TYPE>(raw) + E::get<E::CONTENT_SIZE>(raw);
+}
+
+static uint64_t schemaDecodeHeader(const uint8_t* raw) {
+    using H = wire::ResponseHeader;
+    return H::get<H::VERSION>(raw) + H::get<H::CODE>(raw) + H::get<H::PAYLOAD_SIZE>(raw);
+}
+
+int main() {
+    const size_t OPS     = 20000000;
+    const size_t RECORDS = 4096;   // decode input cycles through this many records
+
+    constexpr size_t FRAME = wire::RequestHeader::SIZE + wire::MessageBody::SIZE;
+    static_assert(FRAME == 44, "header + 603 body head");
+
+    std::mt19937 rng(7);
+    ClientId from, to;
+    for (auto& b : from.bytes) b = static_cast<uint8_t>(rng());
+    for (auto& b : to.bytes)   b = static_cast<uint8_t>(rng());
+    std::vector<uint8_t> entries(RECORDS * wire::MessageEntry::SIZE);
+    for (auto& b : entries) b = static_cast<uint8_t>(rng());
+
+    // Same bytes from both encoders
+    uint8_t a[FRAME], b[FRAME];
+    handEncode(a, from, to, 12345);
+    schemaEncode(b, from, to, 12345);
+    if (std::memcmp(a, b, FRAME) != 0) {
+        std::cerr << "encoders disagree\n";
+        return 1;
+    }
+    for (size_t i = 0; i < RECORDS; ++i) {
+        const uint8_t* e = entries.data() + i * wire::MessageEntry::SIZE;
+        if (handDecodeEntry(e) != schemaDecodeEntry(e) ||
+            handDecodeHeader(e) != schemaDecodeHeader(e)) {
+            std::cerr << "decoders disagree\n";
+            return 1;
+        }
+    }
+
+    uint8_t out[FRAME];
+    double encHand = nsPerOp(OPS, [&] {
+        for (size_t i = 0; i < OPS; ++i) {
+            handEncode(out, from, to, static_cast<uint32_t>(i));
+            sink(out[FRAME - 1]);
+        }
+    });
+    double encSchema = nsPerOp(OPS, [&] {
+        for (size_t i = 0; i < OPS; ++i) {
+            schemaEncode(out, from, to, static_cast<uint32_t>(i));
+            sink(out[FRAME - 1]);
+        }
+    });
+
+    auto decodeLoop = [&](uint64_t (*decode)(const uint8_t*)) {
+        return nsPerOp(OPS, [&] {
+            uint64_t acc = 0;
+            for (size_t i = 0; i < OPS; ++i) {
+                acc += decode(entries.data() + (i % RECORDS) * wire::MessageEntry::SIZE);
+            }
+            sink(acc);
+        });
+    };
+    double entHand    = decodeLoop(handDecodeEntry);
+    double entSchema  = decodeLoop(schemaDecodeEntry);
+    double hdrHand    = decodeLoop(handDecodeHeader);
+    double hdrSchema  = decodeLoop(schemaDecodeHeader);
+
+    std::cout << OPS << " ops each\n"
+              << std::setw(30) << "operation" << std::setw(12) << "hand ns"
+              << std::setw(12) << "schema ns" << "\n"
+              << std::fixed << std::setprecision(2)
+              << std::setw(30) << "encode header + 603 body"
+              << std::setw(12) << encHand << std::setw(12) << encSchema << "\n"
+              << std::setw(30) << "decode 2104 entry head"
+              << std::setw(12) << entHand << std::setw(12) << entSchema << "\n"
+              << std::setw(30) << "decode response header"
+              << std::setw(12) << hdrHand << std::setw(12) << hdrSchema << "\n";
+    return 0;
+}
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# bench_registry.py - fetch latency vs. global backlog size
+#
+# Fills a ClientRegistry with a backlog spread over many recipients, then
+# times fetch_messages for one recipient that has only a few messages queued.
+# With per-recipient mailboxes the fetch time should stay flat as the backlog
+# grows. Run from the server/ directory:
+#
+#   python bench_registry.py [backlog sizes...]
+
+import sys
+import time
+import uuid
+
+from registry import ClientRegistry
+
+MY_MESSAGES = 10          # messages queued for the fetching client
+RECIPIENTS = 10_000       # other recipients sharing the backlog
+REPEATS = 200             # fetches timed per backlog size
+CONTENT = b'x' * 64
+
+
+def fill(registry: ClientRegistry, backlog: int, others: list) -> None:
+    sender = uuid.uuid4().bytes
+    for i in range(backlog):
+        registry.store_message(sender, others[i % len(others)], 3, CONTENT)
+
+
+def time_fetch(registry: ClientRegistry, me: bytes) -> float:
+    sender = uuid.uuid4().bytes
+    total = 0.0
+    for _ in range(REPEATS):
+        for _ in range(MY_MESSAGES):
+            registry.store_message(sender, me, 3, CONTENT)
+        start = time.perf_counter()
+        fetched = registry.fetch_messages(me)
+        total += time.perf_counter() - start
+        assert len(fetched) == MY_MESSAGES
+    return total / REPEATS
+
+
+def main() -> None:
+    sizes = [int(a) for a in sys.argv[1:]] or [1_000, 10_000, 100_000, 1_000_000, 3_000_000]
+    others = [uuid.uuid4().bytes for _ in range(RECIPIENTS)]
+    me = uuid.uuid4().bytes
+
+    print(f"{'backlog':>12} {'fill s':>10} {'fetch us':>10}")
+    for size in sizes:
+        registry = ClientRegistry()
+        start = time.perf_counter()
+        fill(registry, size, others)
+        fill_s = time.perf_counter() - start
+        fetch_us = time_fetch(registry, me) * 1e6
+        print(f"{size:>12} {fill_s:>10.2f} {fetch_us:>10.2f}")
+
+
+if __name__ == '__main__':
+    main()
@@ -6,6 +6,17 @@ from typing import Callable, Dict, Tuple
 from protocol import Protocol
 from registry import ClientRegistry, parse_register_payload
 
+# 603 msg_type high bit: content was deflated before encryption (text / file only)
+MSG_COMPRESSED = 0x80
+MSG_TYPE_MASK = 0x7F
+COMPRESSIBLE_TYPES = (3, 4)
+
+# members listed in one 606; bounds the fan-out a single request can cause
+GROUP_MEMBERS_MAX = 1024
+
+# longest a 609 is held open; clients re-issue it to keep waiting
+LONG_POLL_MAX_MS = 60000
+
 
 class HandlerContext:
     def __init__(self, client_id: bytes, version: int, payload: bytes, registry: ClientRegistry):
@@ -41,18 +52,39 @@ def handle_users_list(ctx: HandlerContext) -> bytes:
     Handle clients list requests (code 601).
     Return response code 2101 with binary list of other clients.
     """
-    entries = []
-    for uid, (name, _, _) in ctx.registry.get_all().items():
-        if uid == ctx.client_id:
-            continue
-        entry = uid
-        name_bytes = name.encode('ascii') + b'\0'
-        entry += name_bytes.ljust(255, b'\0')
-        entries.append(entry)
+    entries = [e for e in ctx.registry.get_list_entries() if e[:16] != ctx.client_id]
     body = b''.join(entries)
     return Protocol.make_response(ctx.version, 2101, body)
 
 
+def handle_users_list_delta(ctx: HandlerContext) -> bytes:
+    """
+    Handle incremental clients list requests (code 608).
+    Payload: [8B last_seen_version] (0 = nothing seen yet)
+    Response code 2108:
+      [8B version][1B full][4B added count][added × 271B record]
+      [4B removed count][removed × 16s client_id]
+    Clients are never removed by this server, so the removed list is
+    always empty; the field keeps the format open for a removal request.
+    With full = 1 the added records are the whole list and replace the
+    client's copy.
+    """
+    if len(ctx.payload) != 8:
+        return Protocol.make_response(ctx.version, 9000)
+    since = struct.unpack('<Q', ctx.payload)[0]
+
+    version, full, added, removed = ctx.registry.list_changes(since)
+    added = [e for e in added if e[:16] != ctx.client_id]
+
+    body = b''.join([
+        struct.pack('<QBI', version, 1 if full else 0, len(added)),
+        *added,
+        struct.pack('<I', len(removed)),
+        *removed,
+    ])
+    return Protocol.make_response(ctx.version, 2108, body)
+
+
 def handle_get_public_key(ctx: HandlerContext) -> bytes:
     """
     Handle public key requests (code 602).
@@ -65,6 +97,29 @@ def handle_get_public_key(ctx: HandlerContext) -> bytes:
     return Protocol.make_response(ctx.version, 2102, target_id + public_key)
 
 
+def handle_get_public_keys(ctx: HandlerContext) -> bytes:
+    """
+    Handle batched public key requests (code 607).
+    Payload: [2B count][count × 16s client_id]
+    Response code 2107: [2B count] + per known ID [16s client_id][2B key_len][key].
+    Unknown IDs are left out, so count may be smaller than requested.
+    """
+    data = ctx.payload
+    if len(data) < 2:
+        return Protocol.make_response(ctx.version, 9000)
+    count = struct.unpack('<H', data[0:2])[0]
+    if len(data) != 2 + 16 * count:
+        return Protocol.make_response(ctx.version, 9000)
+
+    ids = [data[2 + 16 * i:18 + 16 * i] for i in range(count)]
+    found = ctx.registry.get_public_keys(ids)
+
+    parts = [struct.pack('<H', len(found))]
+    for client_id, public_key in found:
+        parts.append(client_id + struct.pack('<H', len(public_key)) + public_key)
+    return Protocol.make_response(ctx.version, 2107, b''.join(parts))
+
+
 def handle_send_message(ctx: HandlerContext) -> bytes:
     data = ctx.payload
     if len(data) < 21:
@@ -79,14 +134,22 @@ def handle_send_message(ctx: HandlerContext) -> bytes:
 
     content = data[21:21 + content_sz]
 
-    if msg_type == 1:
+    # The high bit marks deflated text / file content; it is stored with the
+    # message so the recipient knows to inflate after decrypting
+    base_type = msg_type & MSG_TYPE_MASK
+    if msg_type & MSG_COMPRESSED and base_type not in COMPRESSIBLE_TYPES:
+        return Protocol.make_response(ctx.version, 9000)
+
+    if base_type == 1:
         processed = handle_key_request(ctx, to_id, content)
-    elif msg_type == 2:
+    elif base_type == 2:
         processed = handle_symkey_transfer(ctx, to_id, content)
-    elif msg_type == 3:
+    elif base_type == 3:
         processed = handle_text_message(ctx, to_id, content)
-    elif msg_type == 4:
+    elif base_type == 4:
         processed = handle_file_transfer(ctx, to_id, content)
+    elif base_type == 5:
+        processed = handle_group_key_transfer(ctx, to_id, content)
     else:
         return Protocol.make_response(ctx.version, 9000)
 
@@ -100,19 +163,66 @@ def handle_send_message(ctx: HandlerContext) -> bytes:
     return Protocol.make_response(ctx.version, 2103, resp_body)
 
 
-def handle_fetch_messages(ctx: HandlerContext) -> bytes:
+def _encode_message_entries(messages) -> bytes:
     """
-    Handle message fetch requests (code 604).
-    Response code 2104 with entries:
+    Encode messages as 2104 entries:
       [16s from_client][4B msg_id][1B msg_type][4B size][content…]
     """
     parts = []
-    for msg_id, to_client, from_client, msg_type, content in ctx.registry.fetch_messages(ctx.client_id):
+    for msg_id, to_client, from_client, msg_type, content in messages:
         entry = from_client
         entry += struct.pack('<I B I', msg_id, msg_type, len(content))
         entry += content
         parts.append(entry)
-    return Protocol.make_response(ctx.version, 2104, b''.join(parts))
+    return b''.join(parts)
+
+
+def handle_fetch_messages(ctx: HandlerContext) -> bytes:
+    """
+    Handle message fetch requests (code 604).
+    Response code 2104 with entries:
+      [16s from_client][4B msg_id][1B msg_type][4B size][content…]
+    """
+    body = _encode_message_entries(ctx.registry.fetch_messages(ctx.client_id))
+    return Protocol.make_response(ctx.version, 2104, body)
+
+
+def handle_fetch_messages_page(ctx: HandlerContext) -> bytes:
+    """
+    Handle paged message fetch requests (code 605).
+    Payload: [4B max_bytes][4B max_count]
+    Response code 2105: [1B more_pending] followed by 2104-style entries.
+    """
+    if len(ctx.payload) != 8:
+        return Protocol.make_response(ctx.version, 9000)
+    max_bytes, max_count = struct.unpack('<I I', ctx.payload)
+    if max_count == 0:
+        return Protocol.make_response(ctx.version, 9000)
+
+    messages, more = ctx.registry.fetch_messages_page(ctx.client_id, max_bytes, max_count)
+    body = struct.pack('<B', 1 if more else 0) + _encode_message_entries(messages)
+    return Protocol.make_response(ctx.version, 2105, body)
+
+
+def handle_wait_messages(ctx: HandlerContext) -> bytes:
+    """
+    Handle long-poll message requests (code 609).
+    Payload: [4B timeout_ms][4B max_bytes][4B max_count]
+    If nothing is queued the response is held until a message is stored for
+    the caller or timeout_ms (at most LONG_POLL_MAX_MS) passes.
+    Response code 2109, laid out like 2105: [1B more_pending] + entries
+    (none after a timeout).
+    """
+    if len(ctx.payload) != 12:
+        return Protocol.make_response(ctx.version, 9000)
+    timeout_ms, max_bytes, max_count = struct.unpack('<I I I', ctx.payload)
+    if max_count == 0:
+        return Protocol.make_response(ctx.version, 9000)
+
+    timeout = min(timeout_ms, LONG_POLL_MAX_MS) / 1000.0
+    messages, more = ctx.registry.wait_messages_page(ctx.client_id, timeout, max_bytes, max_count)
+    body = struct.pack('<B', 1 if more else 0) + _encode_message_entries(messages)
+    return Protocol.make_response(ctx.version, 2109, body)
 
 
 def handle_key_request(ctx: HandlerContext, to_id: bytes, content: bytes) -> bytes:
@@ -159,6 +269,63 @@ def handle_file_transfer(ctx: HandlerContext, to_id: bytes, content: bytes) -> b
     return content
 
 
+def handle_group_key_transfer(ctx: HandlerContext, to_id: bytes, content: bytes) -> bytes:
+    """
+    Handle message type 5 (group key for one member):
+      • verify the recipient exists
+      • store [group_id][name][members][RSA-encrypted group key] as-is
+    """
+    if ctx.registry.get_public_key(to_id) is None:
+        return b''
+    return content
+
+
+def handle_send_group_message(ctx: HandlerContext) -> bytes:
+    """
+    Handle group messages (code 606).
+    Payload: [16s group_id][2B count][count × 16s member_id][1B msg_type][4B size][content…]
+    The member list must include the sender and hold at most
+    GROUP_MEMBERS_MAX IDs. The content is stored once and queued for every
+    known member except the sender; members receive a 2104 entry of
+    msg_type whose content is [16s group_id][content].
+    Response code 2106: [16s group_id][4B msg_id].
+    """
+    data = ctx.payload
+    if len(data) < 18:
+        return Protocol.make_response(ctx.version, 9000)
+
+    group_id = data[0:16]
+    count = struct.unpack('<H', data[16:18])[0]
+    if count > GROUP_MEMBERS_MAX:
+        return Protocol.make_response(ctx.version, 9000)
+    off = 18 + 16 * count
+    if len(data) < off + 5:
+        return Protocol.make_response(ctx.version, 9000)
+
+    msg_type = data[off]
+    content_sz = struct.unpack('<I', data[off + 1:off + 5])[0]
+    if msg_type != 6 or off + 5 + content_sz != len(data):
+        return Protocol.make_response(ctx.version, 9000)
+
+    members = dict.fromkeys(data[18 + 16 * i:34 + 16 * i] for i in range(count))
+    if ctx.client_id not in members:
+        return Protocol.make_response(ctx.version, 9000)
+    recipients = [m for m in members
+                  if m != ctx.client_id and ctx.registry.get_public_key(m) is not None]
+    if not recipients:
+        return Protocol.make_response(ctx.version, 9000)
+
+    shared = group_id + data[off + 5:]
+    msg_id = ctx.registry.store_group_message(
+        from_client=ctx.client_id,
+        group_id=group_id,
+        recipients=recipients,
+        msg_type=msg_type,
+        content=shared
+    )
+    return Protocol.make_response(ctx.version, 2106, group_id + struct.pack('<I', msg_id))
+
+
 # map request codes to handler functions
 HANDLERS: Dict[int, Callable[[HandlerContext], bytes]] = {
     600: handle_register,
@@ -166,4 +333,9 @@ HANDLERS: Dict[int, Callable[[HandlerContext], bytes]] = {
     602: handle_get_public_key,
     603: handle_send_message,
     604: handle_fetch_messages,
+    605: handle_fetch_messages_page,
+    606: handle_send_group_message,
+    607: handle_get_public_keys,
+    608: handle_users_list_delta,
+    609: handle_wait_messages,
 }
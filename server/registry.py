@@ -1,8 +1,11 @@
 # registry.py
 
+import threading
+import time
 import uuid
+from collections import deque
 from datetime import datetime
-from typing import Dict, Tuple, List, Optional
+from typing import Deque, Dict, Tuple, List, Optional
 
 def parse_register_payload(payload: bytes) -> Tuple[str, bytes]:
     name = payload[:255].split(b'\0', 1)[0].decode('ascii')
@@ -10,48 +13,206 @@ def parse_register_payload(payload: bytes) -> Tuple[str, bytes]:
     pubkey = payload[offset:]         # Take the rest as the DER-encoded public key
     return name, pubkey
 
+def encode_user_entry(client_id: bytes, username: str) -> bytes:
+    """One clients-list record: [16s client_id][255s NUL-padded username]."""
+    return client_id + (username.encode('ascii') + b'\0').ljust(255, b'\0')
+
 class ClientRegistry:
+    # registry changes remembered for delta list requests (608); a client
+    # whose version is older than that gets the full list instead
+    CHANGE_LOG_MAX = 4096
+
     def __init__(self):
+        # Guards all state below; handle_client threads share one registry
+        self._lock = threading.Lock()
         # client_id → (username, public_key, timestamp)
         self._clients: Dict[bytes, Tuple[str, bytes, datetime]] = {}
-        # message storage: (msg_id, to_client, from_client, msg_type, content)
-        self._messages: List[Tuple[int, bytes, bytes, int, bytes]] = []
+        # per-recipient mailbox, oldest first:
+        #   to_client → deque of (msg_id, to_client, from_client, msg_type, content)
+        self._mailboxes: Dict[bytes, Deque[Tuple[int, bytes, bytes, int, bytes]]] = {}
         self._next_msg_id: int = 1
+        # client_id → encoded clients-list record, built once at registration
+        self._list_entries: Dict[bytes, bytes] = {}
+        # bumped on every registration; _change_log[i] is the client_id
+        # registered at version _log_floor + i + 1
+        self._version: int = 0
+        self._log_floor: int = 0
+        self._change_log: List[bytes] = []
+        # long-poll waiters (609): to_client → [condition on _lock, waiter count];
+        # only recipients with a waiter have an entry, so storing stays O(1)
+        self._waiters: Dict[bytes, list] = {}
 
     def register(self, username: str, public_key: bytes) -> bytes:
         new_id = uuid.uuid4().bytes
-        self._clients[new_id] = (username, public_key, datetime.utcnow())
+        with self._lock:
+            self._clients[new_id] = (username, public_key, datetime.utcnow())
+            self._list_entries[new_id] = encode_user_entry(new_id, username)
+            self._log_change(new_id)
         return new_id
 
+    def _wake(self, to_client: bytes):
+        # caller holds _lock
+        waiter = self._waiters.get(to_client)
+        if waiter is not None:
+            waiter[0].notify_all()
+
+    def _log_change(self, client_id: bytes):
+        # caller holds _lock
+        self._version += 1
+        self._change_log.append(client_id)
+        if len(self._change_log) > 2 * self.CHANGE_LOG_MAX:
+            drop = len(self._change_log) - self.CHANGE_LOG_MAX
+            del self._change_log[:drop]
+            self._log_floor += drop
+
+    def list_changes(self, since: int) -> Tuple[int, bool, List[bytes], List[bytes]]:
+        """
+        Returns (version, full, added, removed) for a client that last saw
+        'since'. added holds encoded list records. removed is always empty:
+        clients are never removed. When 'since' is 0, unknown, or older than
+        the change log, full is True and added is the whole list.
+        """
+        with self._lock:
+            version = self._version
+            if since == 0 or since < self._log_floor or since > version:
+                return version, True, list(self._list_entries.values()), []
+            changed = dict.fromkeys(self._change_log[since - self._log_floor:])
+            added = [self._list_entries[cid] for cid in changed]
+        return version, False, added, []
+
+    def get_list_entries(self) -> List[bytes]:
+        """Encoded clients-list records of every registered client."""
+        with self._lock:
+            return list(self._list_entries.values())
+
     def get_all(self) -> Dict[bytes, Tuple[str, bytes, datetime]]:
-        return dict(self._clients)
+        with self._lock:
+            return dict(self._clients)
 
     def get_public_key(self, client_id: bytes) -> Optional[bytes]:
-        rec = self._clients.get(client_id)
+        with self._lock:
+            rec = self._clients.get(client_id)
         return rec[1] if rec else None
 
+    def get_public_keys(self, client_ids: List[bytes]) -> List[Tuple[bytes, bytes]]:
+        """(client_id, public_key) for every known ID, in request order, under one lock."""
+        with self._lock:
+            recs = [(cid, self._clients.get(cid)) for cid in client_ids]
+        return [(cid, rec[1]) for cid, rec in recs if rec]
+
     def store_message(self,
                       from_client: bytes,
                       to_client: bytes,
                       msg_type: int,
                       content: bytes) -> int:
-        msg_id = self._next_msg_id
-        self._next_msg_id += 1
-        self._messages.append((msg_id, to_client, from_client, msg_type, content))
+        """Queue a message for 'to_client' in O(1)."""
+        with self._lock:
+            msg_id = self._next_msg_id
+            self._next_msg_id += 1
+            box = self._mailboxes.get(to_client)
+            if box is None:
+                box = self._mailboxes[to_client] = deque()
+            box.append((msg_id, to_client, from_client, msg_type, content))
+            self._wake(to_client)
+        return msg_id
+
+    def store_group_message(self,
+                            from_client: bytes,
+                            group_id: bytes,
+                            recipients: List[bytes],
+                            msg_type: int,
+                            content: bytes) -> int:
+        """
+        Queue one message for every recipient. A single record (and a single
+        copy of 'content') is shared by all of their mailboxes; its to_client
+        field holds the group ID.
+        """
+        with self._lock:
+            msg_id = self._next_msg_id
+            self._next_msg_id += 1
+            record = (msg_id, group_id, from_client, msg_type, content)
+            for to_client in recipients:
+                box = self._mailboxes.get(to_client)
+                if box is None:
+                    box = self._mailboxes[to_client] = deque()
+                box.append(record)
+                self._wake(to_client)
         return msg_id
 
     def fetch_messages(self, to_client: bytes) -> List[Tuple[int, bytes, bytes, int, bytes]]:
         """
         Remove and return all pending messages for 'to_client'.
         Each tuple is (msg_id, to_client, from_client, msg_type, content).
+        Cost is O(k) in the recipient's own messages, independent of the
+        rest of the server's backlog.
+        """
+        with self._lock:
+            box = self._mailboxes.pop(to_client, None)
+        return list(box) if box else []
+
+    def fetch_messages_page(self,
+                            to_client: bytes,
+                            max_bytes: int,
+                            max_count: int) -> Tuple[List[Tuple[int, bytes, bytes, int, bytes]], bool]:
         """
-        pending = [m for m in self._messages if m[1] == to_client]
-        self._messages = [m for m in self._messages if m[1] != to_client]
-        return pending
+        Remove and return the oldest pending messages for 'to_client' that fit
+        in the budget, plus whether more remain queued. Size is counted as the
+        encoded 2104 entry (25-byte header + content). The first message is
+        always taken, even if it alone exceeds max_bytes, so large messages
+        can't get stuck.
+        """
+        with self._lock:
+            return self._take_page(to_client, max_bytes, max_count)
+
+    def wait_messages_page(self,
+                           to_client: bytes,
+                           timeout: float,
+                           max_bytes: int,
+                           max_count: int) -> Tuple[List[Tuple[int, bytes, bytes, int, bytes]], bool]:
+        """
+        Like fetch_messages_page, but if nothing is queued, block until a
+        message is stored for 'to_client' or 'timeout' seconds pass (then
+        the page is empty). The waiting thread holds no lock.
+        """
+        deadline = time.monotonic() + timeout
+        with self._lock:
+            if not self._mailboxes.get(to_client):
+                waiter = self._waiters.get(to_client)
+                if waiter is None:
+                    waiter = self._waiters[to_client] = [threading.Condition(self._lock), 0]
+                waiter[1] += 1
+                try:
+                    while not self._mailboxes.get(to_client):
+                        remaining = deadline - time.monotonic()
+                        if remaining <= 0 or to_client not in self._clients:
+                            break
+                        waiter[0].wait(remaining)
+                finally:
+                    waiter[1] -= 1
+                    if waiter[1] == 0:
+                        del self._waiters[to_client]
+            return self._take_page(to_client, max_bytes, max_count)
+
+    def _take_page(self, to_client: bytes, max_bytes: int, max_count: int):
+        # caller holds _lock
+        page: List[Tuple[int, bytes, bytes, int, bytes]] = []
+        used = 0
+        box = self._mailboxes.get(to_client)
+        while box and len(page) < max_count:
+            size = 25 + len(box[0][4])
+            if page and used + size > max_bytes:
+                break
+            page.append(box.popleft())
+            used += size
+        more = bool(box)
+        if box is not None and not box:
+            del self._mailboxes[to_client]
+        return page, more
 
 
     def update_last_seen(self, client_id: bytes):
         """Update the last_seen timestamp for an existing client."""
-        if client_id in self._clients:
-            username, public_key, _ = self._clients[client_id]
-            self._clients[client_id] = (username, public_key, datetime.utcnow())
+        with self._lock:
+            if client_id in self._clients:
+                username, public_key, _ = self._clients[client_id]
+                self._clients[client_id] = (username, public_key, datetime.utcnow())